@@ -0,0 +1,42 @@
+/*
+ *	Filling OpenGL buffers through write-only mappings, so data that is converted or generated on upload
+ *	is written in place instead of through a temporary copy.
+ */
+
+#ifndef GLBUFFERFILL_H
+#define GLBUFFERFILL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <vector>
+
+// Write the first bytes of the store of the buffer bound to target with fill(unsigned char* out), through a
+// mapping that invalidates the whole store. The store is filled again if its content was lost while mapped
+// (glUnmapBuffer fails), and from a temporary copy if it can not be mapped at all
+template <typename Fill>
+void writeBuffer(GLenum target, size_t bytes, Fill fill)
+{
+	if (bytes == 0) return;
+
+	for (int attempt = 0; attempt < 3; attempt++)
+	{
+		void* mapped = glMapBufferRange(target, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!mapped) break;
+
+		fill(static_cast<unsigned char*>(mapped));
+		if (glUnmapBuffer(target) == GL_TRUE) return;
+	}
+
+	std::vector<unsigned char> data(bytes);
+	fill(data.data());
+	glBufferSubData(target, 0, bytes, data.data());
+}
+
+// Allocate a new store of the given size for the buffer bound to target and write it with fill
+template <typename Fill>
+void fillBuffer(GLenum target, size_t bytes, Fill fill, GLenum usage = GL_STATIC_DRAW)
+{
+	glBufferData(target, bytes, nullptr, usage);
+	writeBuffer(target, bytes, fill);
+}
+#endif
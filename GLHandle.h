@@ -0,0 +1,80 @@
+/*
+ *	Move-only ownership of OpenGL objects. The object is deleted when the handle is destroyed
+ *	or given a new object, so rebuilding a mesh or a shader does not leak GL objects.
+ *	Handles convert to GLuint, so they can be passed straight to the gl* functions.
+ */
+
+#ifndef GLHANDLE_H
+#define GLHANDLE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <utility>
+
+// How to create and delete each kind of object
+struct GLBufferTraits {
+	static GLuint create() { GLuint id; glGenBuffers(1, &id); return id; }
+	static void destroy(GLuint id) { glDeleteBuffers(1, &id); }
+};
+
+struct GLVertexArrayTraits {
+	static GLuint create() { GLuint id; glGenVertexArrays(1, &id); return id; }
+	static void destroy(GLuint id) { glDeleteVertexArrays(1, &id); }
+};
+
+struct GLProgramTraits {
+	static GLuint create() { return glCreateProgram(); }
+	static void destroy(GLuint id) { glDeleteProgram(id); }
+};
+
+template <typename Traits>
+class GLHandle {
+public:
+	GLHandle() = default;
+
+	// take ownership of an existing object
+	explicit GLHandle(GLuint id) : id(id) {}
+
+	// create a new object
+	static GLHandle create() { return GLHandle(Traits::create()); }
+
+	~GLHandle() { reset(); }
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+
+	GLHandle(GLHandle&& other) noexcept : id(other.release()) {}
+
+	GLHandle& operator=(GLHandle&& other) noexcept
+	{
+		if (this != &other) reset(other.release());
+		return *this;
+	}
+
+	operator GLuint() const { return id; }
+	GLuint get() const { return id; }
+
+	// delete the owned object (if any) and take ownership of a new one
+	void reset(GLuint newId = 0)
+	{
+		if (id != 0) Traits::destroy(id);
+		id = newId;
+	}
+
+	// give up ownership without deleting the object
+	GLuint release()
+	{
+		GLuint old = id;
+		id = 0;
+		return old;
+	}
+
+private:
+	GLuint id = 0;
+};
+
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLProgramTraits> GLProgram;
+
+#endif
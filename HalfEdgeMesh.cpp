@@ -0,0 +1,292 @@
+#include "HalfEdgeMesh.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "Parallel.h"
+
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+
+const GLuint HalfEdgeMesh::INVALID;
+
+// Hash for exact position matches. Adding 0.0f turns -0.0f into 0.0f so the hash agrees with ==
+struct PositionHash
+{
+	size_t operator()(const glm::vec3& p) const {
+		uint32_t bits[3];
+		glm::vec3 q = p + glm::vec3(0.0f);
+		std::memcpy(bits, &q[0], sizeof(bits));
+		uint64_t h = bits[0];
+		h = h * 0x9E3779B97F4A7C15ULL ^ bits[1];
+		h = h * 0x9E3779B97F4A7C15ULL ^ bits[2];
+		return size_t(h ^ (h >> 32));
+	}
+};
+
+// Key for the undirected edge between two unique vertices
+static uint64_t edgeKey(GLuint a, GLuint b)
+{
+	if (a > b) std::swap(a, b);
+	return (uint64_t(a) << 32) | b;
+}
+
+// Mix the bits of a 64-bit key, used to spread keys over the hash table partitions
+static uint32_t mixKey(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xFF51AFD7ED558CCDULL;
+	k ^= k >> 33;
+	return uint32_t(k);
+}
+
+// ***************************************************************************
+// * PUBLIC
+// ***************************************************************************
+
+HalfEdgeMesh::HalfEdgeMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, unsigned threads)
+{
+	build(vertices, indices, threads);
+}
+
+void HalfEdgeMesh::build(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, unsigned threads)
+{
+	clear();
+	threads = Parallel::numThreads(threads);
+	weldVertices(vertices, indices, threads);
+	linkTwins(threads);
+}
+
+// Build the same mesh with 1, 2, 4, 8 and 16 threads and print the time and speedup of each
+void HalfEdgeMesh::reportBuildScaling(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	const unsigned threadCounts[] = { 1, 2, 4, 8, 16 };
+	const int repetitions = 3;
+
+	HalfEdgeMesh reference(vertices, indices, 1);
+	std::vector<GLuint> referenceAdjacency;
+	reference.genAdjacencyIndices(referenceAdjacency);
+
+	printf("HalfEdgeMesh build scaling: %u triangles, %u hardware threads\n",
+		reference.numFaces(), Parallel::numThreads());
+
+	double serialTime = 0.0;
+	for (unsigned threads : threadCounts)
+	{
+		// Best of a few runs to reduce noise
+		double bestTime = 0.0;
+		HalfEdgeMesh mesh;
+		for (int r = 0; r < repetitions; r++)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			mesh.build(vertices, indices, threads);
+			auto endTime = std::chrono::high_resolution_clock::now();
+			double time = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+			if (r == 0 || time < bestTime) bestTime = time;
+		}
+		if (threads == 1) serialTime = bestTime;
+
+		std::vector<GLuint> adjacency;
+		mesh.genAdjacencyIndices(adjacency);
+		bool identical = (adjacency == referenceAdjacency) && (mesh.twins == reference.twins) && (mesh.origins == reference.origins);
+
+		printf("  %2u threads: %9.2f ms  speedup %5.2fx  %s\n",
+			threads, bestTime, serialTime / bestTime, identical ? "identical" : "MISMATCH");
+	}
+}
+
+void HalfEdgeMesh::clear()
+{
+	// Swap with an empty mesh so the memory is actually released
+	HalfEdgeMesh().swap(*this);
+}
+
+void HalfEdgeMesh::swap(HalfEdgeMesh& other)
+{
+	positions.swap(other.positions);
+	sourceIndices.swap(other.sourceIndices);
+	vertexHalfEdges.swap(other.vertexHalfEdges);
+	corners.swap(other.corners);
+	origins.swap(other.origins);
+	twins.swap(other.twins);
+	std::swap(nEdges, other.nEdges);
+	std::swap(nBoundaryEdges, other.nBoundaryEdges);
+	std::swap(nNonManifoldEdges, other.nNonManifoldEdges);
+}
+
+size_t HalfEdgeMesh::memoryBytes() const
+{
+	return positions.capacity() * sizeof(glm::vec3)
+		+ (sourceIndices.capacity() + vertexHalfEdges.capacity() + corners.capacity()
+			+ origins.capacity() + twins.capacity()) * sizeof(GLuint);
+}
+
+glm::vec3 HalfEdgeMesh::faceNormal(GLuint f) const
+{
+	GLuint h = faceHalfEdge(f);
+	const glm::vec3 &p0 = positions[origins[h]];
+	const glm::vec3 &p1 = positions[origins[h + 1]];
+	const glm::vec3 &p2 = positions[origins[h + 2]];
+	return glm::cross(p1 - p0, p2 - p1);
+}
+
+bool HalfEdgeMesh::facesLight(GLuint f, const glm::vec3& lightPos) const
+{
+	const glm::vec3 &p0 = positions[origins[faceHalfEdge(f)]];
+	return glm::dot(faceNormal(f), p0 - lightPos) <= 0.0f;
+}
+
+// Each triangle becomes (v0, n0, v1, n1, v2, n2), where ni is the vertex opposite to
+// the edge (vi, vi+1) in the neighboring triangle.
+void HalfEdgeMesh::genAdjacencyIndices(std::vector<GLuint>& adjacencyIndices) const
+{
+	adjacencyIndices.resize(2 * corners.size());
+
+	for (GLuint h = 0; h < numHalfEdges(); h++)
+	{
+		// Original vertice stays the same 
+		adjacencyIndices[2 * h] = corners[h];
+
+		// Neighboring vertice is at the origin of the half-edge before the twin.
+		// Boundary edges have no neighbor and fall back to index 0, like before.
+		GLuint t = twins[h];
+		adjacencyIndices[2 * h + 1] = (t == INVALID) ? 0 : sourceIndices[origins[prev(t)]];
+	}
+}
+
+void HalfEdgeMesh::genEdgeListIndices(std::vector<GLuint>& edgeIndices) const
+{
+	edgeIndices.clear();
+	edgeIndices.reserve(4 * (nEdges + nNonManifoldEdges));
+
+	for (GLuint h = 0; h < numHalfEdges(); h++)
+	{
+		GLuint t = twins[h];
+
+		// Manifold edges are added from the half-edge with the lowest index. Extra half-edges
+		// on non-manifold edges point at the first half-edge and are added paired with it.
+		if (t != INVALID && twins[t] == h && t < h) continue;
+
+		GLuint opposite = sourceIndices[origins[prev(h)]];
+
+		edgeIndices.push_back(sourceIndices[origin(h)]);
+		edgeIndices.push_back(sourceIndices[target(h)]);
+		edgeIndices.push_back(opposite);
+		edgeIndices.push_back((t == INVALID) ? opposite : sourceIndices[origins[prev(t)]]);
+	}
+}
+
+void HalfEdgeMesh::findSilhouetteEdges(const glm::vec3& lightPos, std::vector<GLuint>& silhouette) const
+{
+	silhouette.clear();
+
+	std::vector<bool> lit(numFaces());
+	for (GLuint f = 0; f < numFaces(); f++)
+	{
+		lit[f] = facesLight(f, lightPos);
+	}
+
+	for (GLuint h = 0; h < numHalfEdges(); h++)
+	{
+		if (!lit[face(h)]) continue;
+
+		GLuint t = twins[h];
+		if (t == INVALID || !lit[face(t)]) silhouette.push_back(h);
+	}
+}
+
+// ***************************************************************************
+// * PRIVATE
+// ***************************************************************************
+
+// If a position vector is duplicated in the VB we only keep the index of the first occurrence.
+// The corners are numbered by their position with MeshOptimizer::findUnique
+void HalfEdgeMesh::weldVertices(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, unsigned threads)
+{
+	const size_t ncorners = indices.size();
+	PositionHash hasher;
+
+	corners = indices;
+
+	std::vector<GLuint> firsts;
+	const GLuint nunique = MeshOptimizer::findUnique(ncorners,
+		[&](size_t i) { return hasher(vertices[indices[i]].Position); },
+		[&](size_t i, size_t j) { return vertices[indices[i]].Position == vertices[indices[j]].Position; },
+		origins, firsts, threads);
+
+	positions.resize(nunique);
+	sourceIndices.resize(nunique);
+	vertexHalfEdges.resize(nunique);
+
+	// The first corner of every unique vertex is also its outgoing half-edge
+	Parallel::forChunks(nunique, threads, [&](size_t begin, size_t end, unsigned) {
+		for (size_t v = begin; v < end; v++)
+		{
+			GLuint first = firsts[v];
+			positions[v] = vertices[indices[first]].Position;
+			sourceIndices[v] = indices[first];
+			vertexHalfEdges[v] = first;
+		}
+	});
+}
+
+// Half-edges are paired on their undirected edge, so inconsistently wound neighbors still connect.
+// Edges shared by more than two faces (non-manifold) point the extra half-edges at the first one.
+// As for welding, edges are split over one hash table per thread and every table is filled in serial order.
+void HalfEdgeMesh::linkTwins(unsigned threads)
+{
+	struct EdgeEntry {
+		GLuint first;	// First half-edge found on the edge
+		GLuint count;	// Number of half-edges on the edge
+	};
+
+	const GLuint nhalfedges = numHalfEdges();
+	twins.assign(nhalfedges, INVALID);
+
+	std::vector<uint64_t> keys(nhalfedges);
+	std::vector<uint32_t> partition(nhalfedges);
+	Parallel::forChunks(nhalfedges, threads, [&](size_t begin, size_t end, unsigned) {
+		for (size_t h = begin; h < end; h++)
+		{
+			keys[h] = edgeKey(origin(GLuint(h)), target(GLuint(h)));
+			partition[h] = mixKey(keys[h]) % threads;
+		}
+	});
+
+	std::vector<GLuint> edgeCount(threads, 0), boundaryCount(threads, 0), nonManifoldCount(threads, 0);
+
+	Parallel::forEachThread(threads, [&](unsigned t) {
+		std::unordered_map<uint64_t, EdgeEntry> edges;
+		edges.reserve(nhalfedges / threads + 1);
+
+		for (GLuint h = 0; h < nhalfedges; h++)
+		{
+			if (partition[h] != t) continue;
+
+			EdgeEntry &edge = edges.emplace(keys[h], EdgeEntry{ h, 0 }).first->second;
+			edge.count++;
+
+			if (edge.count == 2) {
+				twins[edge.first] = h;
+			}
+			if (edge.count >= 2) {
+				twins[h] = edge.first;
+			}
+		}
+
+		edgeCount[t] = GLuint(edges.size());
+		for (const auto &edge : edges)
+		{
+			if (edge.second.count == 1) boundaryCount[t]++;
+			else if (edge.second.count > 2) nonManifoldCount[t]++;
+		}
+	});
+
+	for (unsigned t = 0; t < threads; t++)
+	{
+		nEdges += edgeCount[t];
+		nBoundaryEdges += boundaryCount[t];
+		nNonManifoldEdges += nonManifoldCount[t];
+	}
+}
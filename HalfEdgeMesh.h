@@ -0,0 +1,111 @@
+/*
+ *	Half-edge representation of a triangle mesh, used as the connectivity backing store for occluders.
+ *	Vertices with the same position are welded to one unique vertex, and every triangle is stored as
+ *	three consecutive half-edges, so next, prev and face lookups are implicit and twins are a single array read.
+ *
+ *	The mesh is used to generate index buffers for GL_TRIANGLES_ADJACENCY and for CPU-side silhouette queries.
+ */
+
+#ifndef HALFEDGEMESH_H
+#define HALFEDGEMESH_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct Vertex;
+
+class HalfEdgeMesh {
+public:
+	// Index used for a missing twin (boundary edge)
+	static const GLuint INVALID = 0xFFFFFFFF;
+
+	HalfEdgeMesh() = default;
+
+	// Build the half-edge mesh from a vertex buffer and a triangle index list
+	HalfEdgeMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, unsigned threads = 0);
+
+	// Build the half-edge mesh from a vertex buffer and a triangle index list, replacing any previous content.
+	// The build is split over the given number of threads (0 = all cores). The result does not depend on the thread count.
+	void build(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, unsigned threads = 0);
+
+	// Time the build with 1, 2, 4, 8 and 16 threads and print the speedup compared to the serial build
+	static void reportBuildScaling(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+	// Release all data
+	void clear();
+
+	// Exchange the content of two meshes
+	void swap(HalfEdgeMesh& other);
+
+	// Bytes of CPU memory held by the mesh
+	size_t memoryBytes() const;
+
+	bool empty() const { return origins.empty(); }
+
+	// Sizes
+	GLuint numFaces() const { return GLuint(origins.size() / 3); }
+	GLuint numHalfEdges() const { return GLuint(origins.size()); }
+	GLuint numVertices() const { return GLuint(positions.size()); }
+	GLuint numEdges() const { return nEdges; }
+	GLuint numBoundaryEdges() const { return nBoundaryEdges; }
+	GLuint numNonManifoldEdges() const { return nNonManifoldEdges; }
+
+	// Half-edge navigation. Half-edge h goes from origin(h) to origin(next(h)) in face(h)
+	static GLuint face(GLuint h) { return h / 3; }
+	static GLuint next(GLuint h) { return (h % 3 == 2) ? h - 2 : h + 1; }
+	static GLuint prev(GLuint h) { return (h % 3 == 0) ? h + 2 : h - 1; }
+	static GLuint faceHalfEdge(GLuint f) { return 3 * f; }
+	GLuint twin(GLuint h) const { return twins[h]; }
+	GLuint origin(GLuint h) const { return origins[h]; }
+	GLuint target(GLuint h) const { return origins[next(h)]; }
+	bool isBoundary(GLuint h) const { return twins[h] == INVALID; }
+
+	// One outgoing half-edge of a unique vertex
+	GLuint vertexHalfEdge(GLuint v) const { return vertexHalfEdges[v]; }
+
+	// Position of a unique vertex
+	const glm::vec3& position(GLuint v) const { return positions[v]; }
+
+	// Index in the source vertex buffer of a unique vertex (its first occurrence)
+	GLuint sourceIndex(GLuint v) const { return sourceIndices[v]; }
+
+	// Unnormalized face normal, following the counter-clockwise winding of the triangle
+	glm::vec3 faceNormal(GLuint f) const;
+
+	// Check if a face is facing a point light at lightPos (same test as in shadowVolume.geom)
+	bool facesLight(GLuint f, const glm::vec3& lightPos) const;
+
+	// Generate the 6-index buffer used to draw the mesh with GL_TRIANGLES_ADJACENCY
+	void genAdjacencyIndices(std::vector<GLuint>& adjacencyIndices) const;
+
+	// Generate the index buffer used to draw every unique edge once with GL_LINES_ADJACENCY.
+	// Each edge becomes (start, end, opposite vertex in the first face, opposite vertex in the second face).
+	// Boundary edges repeat the opposite vertex of the first face, which makes them always part of the silhouette.
+	void genEdgeListIndices(std::vector<GLuint>& edgeIndices) const;
+
+	// Find the silhouette edges as seen from a point light at lightPos (given in object space).
+	// Every silhouette edge is returned once, as the half-edge in the face that is facing the light.
+	void findSilhouetteEdges(const glm::vec3& lightPos, std::vector<GLuint>& silhouette) const;
+
+private:
+	std::vector<glm::vec3> positions;		// Position of each unique vertex
+	std::vector<GLuint> sourceIndices;		// Source vertex buffer index of each unique vertex
+	std::vector<GLuint> vertexHalfEdges;	// One outgoing half-edge per unique vertex
+
+	std::vector<GLuint> corners;	// Source vertex buffer index of the origin of each half-edge
+	std::vector<GLuint> origins;	// Unique vertex at the origin of each half-edge
+	std::vector<GLuint> twins;		// Opposite half-edge, or INVALID for boundary edges
+
+	GLuint nEdges = 0;
+	GLuint nBoundaryEdges = 0;
+	GLuint nNonManifoldEdges = 0;
+
+	// Weld vertices with equal positions and fill in the per-vertex data
+	void weldVertices(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, unsigned threads);
+
+	// Pair every half-edge with the half-edge on the other side of the same edge
+	void linkTwins(unsigned threads);
+};
+#endif
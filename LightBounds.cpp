@@ -0,0 +1,114 @@
+#include "LightBounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Not part of the generated loader, EXT_depth_bounds_test is loaded by hand
+#define GL_DEPTH_BOUNDS_TEST_EXT 0x8890
+
+LightBounds::DepthBoundsProc LightBounds::depthBoundsEXT = nullptr;
+
+// Distance to the near plane of a perspective projection
+static float nearDistance(const glm::mat4& projection)
+{
+	return projection[3][2] / (projection[2][2] - 1.0f);
+}
+
+// The sphere is bounded by its axis aligned box in view space. The part of the box in front of the near plane
+// is convex and all its points have a positive w, so its projection lies within the projected corners
+bool LightBounds::scissorRect(const glm::vec3& lightPos, float range, const glm::mat4& view, const glm::mat4& projection,
+	const GLint viewport[4], ScissorRect& rect)
+{
+	glm::vec3 center = glm::vec3(view * glm::vec4(lightPos, 1.0f));
+	float zNear = -nearDistance(projection);
+	if (center.z - range > zNear) return false;
+
+	glm::vec2 lower(1.0f), upper(-1.0f);
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner(center.x + ((i & 1) ? range : -range),
+			center.y + ((i & 2) ? range : -range),
+			std::min(center.z + ((i & 4) ? range : -range), zNear));
+		glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		lower = glm::min(lower, ndc);
+		upper = glm::max(upper, ndc);
+	}
+	lower = glm::max(lower, glm::vec2(-1.0f));
+	upper = glm::min(upper, glm::vec2(1.0f));
+	if (lower.x >= upper.x || lower.y >= upper.y) return false;
+
+	// Round outwards to whole pixels
+	GLint x0 = viewport[0] + GLint(std::floor((0.5f * lower.x + 0.5f) * viewport[2]));
+	GLint y0 = viewport[1] + GLint(std::floor((0.5f * lower.y + 0.5f) * viewport[3]));
+	GLint x1 = viewport[0] + GLint(std::ceil((0.5f * upper.x + 0.5f) * viewport[2]));
+	GLint y1 = viewport[1] + GLint(std::ceil((0.5f * upper.y + 0.5f) * viewport[3]));
+	rect.x = x0;
+	rect.y = y0;
+	rect.width = x1 - x0;
+	rect.height = y1 - y0;
+	return rect.width > 0 && rect.height > 0;
+}
+
+// Window depth is monotonic in the view space depth, so the depths of the nearest and the furthest point of
+// the sphere bound it
+bool LightBounds::depthBounds(const glm::vec3& lightPos, float range, const glm::mat4& view, const glm::mat4& projection,
+	GLclampd& zMin, GLclampd& zMax)
+{
+	glm::vec3 center = glm::vec3(view * glm::vec4(lightPos, 1.0f));
+	float zNear = -nearDistance(projection);
+	if (center.z - range > zNear) return false;
+
+	auto windowDepth = [&projection](float z) {
+		float ndc = (projection[2][2] * z + projection[3][2]) / -z;
+		return GLclampd(glm::clamp(0.5f * ndc + 0.5f, 0.0f, 1.0f));
+	};
+	zMin = windowDepth(std::min(center.z + range, zNear));
+	zMax = windowDepth(center.z - range);
+	return true;
+}
+
+bool LightBounds::loadDepthBoundsTest(GLADloadproc load)
+{
+	depthBoundsEXT = nullptr;
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && std::strcmp(name, "GL_EXT_depth_bounds_test") == 0)
+		{
+			depthBoundsEXT = (DepthBoundsProc)load("glDepthBoundsEXT");
+			break;
+		}
+	}
+	return depthBoundsEXT != nullptr;
+}
+
+bool LightBounds::enable(const glm::vec3& lightPos, float range, const glm::mat4& view, const glm::mat4& projection)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	ScissorRect rect;
+	if (!scissorRect(lightPos, range, view, projection, viewport, rect)) return false;
+
+	glScissor(rect.x, rect.y, rect.width, rect.height);
+	glEnable(GL_SCISSOR_TEST);
+
+	GLclampd zMin, zMax;
+	if (depthBoundsEXT && depthBounds(lightPos, range, view, projection, zMin, zMax))
+	{
+		depthBoundsEXT(zMin, zMax);
+		glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
+	}
+	return true;
+}
+
+void LightBounds::disable()
+{
+	glDisable(GL_SCISSOR_TEST);
+	if (depthBoundsEXT) glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
+}
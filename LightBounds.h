@@ -0,0 +1,46 @@
+/*
+ *	Screen-space bounds of the region a point light can affect. The light only reaches the points within
+ *	its range, so the shadow volume pass and the lit pass of the light are limited to the scissor rectangle
+ *	of that sphere, and, with EXT_depth_bounds_test, to the pixels whose scene depth lies within it.
+ *	Neither changes the image, they only save stencil and shading fill outside of the light's reach.
+ */
+
+#ifndef LIGHTBOUNDS_H
+#define LIGHTBOUNDS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+// Screen rectangle in pixels, as passed to glScissor
+struct ScissorRect {
+	GLint x = 0, y = 0;
+	GLsizei width = 0, height = 0;
+};
+
+class LightBounds {
+public:
+	// Scissor rectangle of the sphere of a light within the viewport (x, y, width, height as from GL_VIEWPORT).
+	// The projection is a perspective projection. Returns false if the sphere is behind the camera or outside
+	// of the viewport, so nothing the light reaches is visible
+	static bool scissorRect(const glm::vec3& lightPos, float range, const glm::mat4& view, const glm::mat4& projection,
+		const GLint viewport[4], ScissorRect& rect);
+
+	// Range of window depths of the sphere of a light, clamped to [0, 1]. Returns false if the sphere is
+	// behind the camera
+	static bool depthBounds(const glm::vec3& lightPos, float range, const glm::mat4& view, const glm::mat4& projection,
+		GLclampd& zMin, GLclampd& zMax);
+
+	// Load glDepthBoundsEXT if the context supports EXT_depth_bounds_test. Call after gladLoadGLLoader
+	static bool loadDepthBoundsTest(GLADloadproc load);
+	static bool hasDepthBoundsTest() { return depthBoundsEXT != nullptr; }
+
+	// Enable the scissor and, if available, the depth bounds test for the sphere of a light. Returns false if
+	// nothing the light reaches is visible, in which case nothing is enabled and its passes can be skipped
+	static bool enable(const glm::vec3& lightPos, float range, const glm::mat4& view, const glm::mat4& projection);
+	static void disable();
+
+private:
+	typedef void (APIENTRYP DepthBoundsProc)(GLclampd zmin, GLclampd zmax);
+	static DepthBoundsProc depthBoundsEXT;
+};
+#endif
@@ -0,0 +1,84 @@
+#include "LodChain.h"
+#include "HalfEdgeMesh.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "SurfaceDistance.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Generate the levels, each from the welded connectivity of the previous one. The quadric error bounds
+// only steer the simplification: the error kept for a level is its measured distance from the full mesh
+void LodChain::build(Mesh& mesh, float baseError, GLuint maxLevels, GLuint minTriangles, float errorStep)
+{
+	base = &mesh;
+	levels.clear();
+	errors.clear();
+	bounds = mesh.getBounds();
+	selected = 0;
+
+	const HalfEdgeMesh& connectivity = mesh.getHalfEdgeMesh();
+	if (connectivity.empty()) {
+		fprintf(stderr, "%s: %s\n", "LOD chain error", "mesh has no half-edge mesh");
+		return;
+	}
+
+	SurfaceDistance baseSurface(connectivity);
+	HalfEdgeMesh previous;
+	const HalfEdgeMesh* source = &connectivity;
+	float step = baseError;
+
+	while (levels.size() + 1 < maxLevels && source->numFaces() > minTriangles)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		GLuint ntris = MeshSimplifier::simplify(*source, step, vertices, indices);
+		if (4 * ntris > 3 * source->numFaces()) break; // Not worth a level
+
+		MeshOptimizer::optimizeMesh("LOD level", vertices, indices);
+		HalfEdgeMesh next(vertices, indices);
+
+		float error = SurfaceDistance::hausdorff(baseSurface, SurfaceDistance(vertices, indices));
+		printf("LodChain: level %u has %u triangles, Hausdorff distance %g from the mesh\n", GLuint(levels.size()) + 1, ntris, error);
+		levels.push_back(Mesh(std::move(vertices), std::move(indices), ntris, mesh.getVertexFormat()));
+		levels.back().setResidency(Residency::ReleaseAll);
+		errors.push_back(error);
+
+		previous.swap(next);
+		source = &previous;
+		step *= errorStep;
+	}
+}
+
+// The error of a level in pixels is its distance from the full mesh, scaled by the model matrix, at the distance of the
+// closest point of the bounding sphere. The projection maps a unit at distance d to projection[1][1] / d
+// half viewport heights
+void LodChain::select(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+	float viewportHeight, float pixelError, float hysteresis)
+{
+	if (levels.empty()) return;
+
+	glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+	float radius = 0.5f * glm::length(bounds.max - bounds.min);
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	glm::vec3 viewCenter = glm::vec3(view * model * glm::vec4(center, 1.0f));
+	float distance = glm::length(viewCenter) - scale * radius;
+	if (distance <= 0.0f) {
+		selected = 0; // Inside the bounding sphere
+		return;
+	}
+
+	float pixelsPerUnit = scale * projection[1][1] * 0.5f * viewportHeight / distance;
+
+	GLuint best = 0;
+	for (GLuint i = numLevels() - 1; i > 0; i--)
+	{
+		float threshold = i > selected ? (1.0f - hysteresis) * pixelError : pixelError;
+		if (levelError(i) * pixelsPerUnit <= threshold) {
+			best = i;
+			break;
+		}
+	}
+	selected = best;
+}
@@ -0,0 +1,52 @@
+/*
+ *	Chain of simplified levels of detail of a render mesh. The levels are generated at load time with
+ *	MeshSimplifier, each from the previous one with a growing error bound, and one level is selected per
+ *	frame from the projected size of its measured distance from the full mesh. The selected level is kept for the whole frame, so the
+ *	ambient and the lit pass draw the same triangles and the lit pass still passes its GL_EQUAL depth test.
+ */
+
+#ifndef LODCHAIN_H
+#define LODCHAIN_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+#include <vector>
+
+class LodChain {
+public:
+	LodChain() = default;
+
+	// Generate the levels of a mesh, which must have its half-edge mesh. The first level is the mesh itself,
+	// which is not owned by the chain. Each next level is simplified with errorStep times the quadric error bound
+	// of the previous one, starting at baseError (in model units), until a level has less than minTriangles
+	// triangles or removes less than a quarter of the triangles of the previous level. The error of each level is
+	// its measured Hausdorff distance from the mesh. The levels are uploaded in the vertex format of the mesh
+	void build(Mesh& mesh, float baseError, GLuint maxLevels = 6, GLuint minTriangles = 64, float errorStep = 4.0f);
+
+	// Select the coarsest level whose error projects to at most pixelError pixels. A coarser level than the
+	// current one must project to at most (1 - hysteresis) * pixelError, so a level does not flicker at the threshold.
+	// viewportHeight is in pixels, and the projection is a perspective projection
+	void select(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+		float viewportHeight, float pixelError = 1.0f, float hysteresis = 0.25f);
+
+	// The selected level
+	Mesh& current() { return level(selected); }
+	GLuint currentLevel() const { return selected; }
+
+	Mesh& level(GLuint i) { return i == 0 ? *base : levels[i - 1]; }
+	GLuint numLevels() const { return base ? GLuint(levels.size()) + 1 : 0; }
+
+	// Measured Hausdorff distance of a level from the full mesh, in model units
+	float levelError(GLuint i) const { return i == 0 ? 0.0f : errors[i - 1]; }
+
+private:
+	Mesh* base = nullptr;
+	std::vector<Mesh> levels;		// Levels 1 and up
+	std::vector<float> errors;		// Hausdorff distance of levels 1 and up from the full mesh
+	Bounds bounds;
+	GLuint selected = 0;
+};
+#endif
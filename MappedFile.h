@@ -0,0 +1,43 @@
+/*
+ *	Read-only memory mapping of a whole file, using CreateFileMapping on Windows and mmap elsewhere.
+ *	The mapping is released when the object is destroyed.
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+class MappedFile {
+public:
+	MappedFile() = default;
+
+	// map the file at path. Check isOpen() for success
+	explicit MappedFile(const char* path);
+
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// map the file at path, replacing any previous mapping
+	bool open(const char* path);
+
+	// unmap the file
+	void close();
+
+	bool isOpen() const { return opened; }
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+	bool opened = false;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+#endif
@@ -1,194 +1,336 @@
 #include "Mesh.h"
+#include "GLBufferFill.h"
+#include "Parallel.h"
+#include "VertexLayout.h"
+
+#include <chrono>
+#include <type_traits>
+
+// Free the memory of a vector (clear() keeps the capacity)
+template <typename T>
+static void releaseVector(std::vector<T>& v)
+{
+	std::vector<T>().swap(v);
+}
+
+Bounds computeBounds(const Vertex* vertices, size_t count)
+{
+	Bounds bounds;
+	if (count == 0) return bounds;
+
+	bounds.min = bounds.max = vertices[0].Position;
+	for (size_t i = 1; i < count; i++)
+	{
+		bounds.min = glm::min(bounds.min, vertices[i].Position);
+		bounds.max = glm::max(bounds.max, vertices[i].Position);
+	}
+	return bounds;
+}
 
 // constructor
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, GLuint ntris)
+// The vectors are moved into the mesh, so callers passing temporaries avoid any deep copy
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, GLuint ntris, VertexFormat format)
+	: vertices(std::move(vertices)), indices(std::move(indices)), ntris(ntris), format(format)
 {
-	this->vertices = vertices;
-	this->indices = indices;
-	this->ntris = ntris;
+	this->nverts = GLuint(this->vertices.size());
 
-	// Adjacency disabled by default => empty
-	this->indicesAdjacency = {};
+	MeshArrays arrays;
+	arrays.vertices = this->vertices.data();
+	arrays.indices = this->indices.data();
+	arrays.nverts = nverts;
+	arrays.ntris = ntris;
+	arrays.bounds = computeBounds(arrays.vertices, nverts);
 
 	// now that we have all the required data, set the vertex buffers and its attribute pointers.
-	setupMesh();
+	setupMesh(arrays);
 }
 
-// default constructor - only used for memory allocation
-Mesh::Mesh()
+// constructor from arrays owned by someone else
+// The GL buffers are filled straight from the arrays, and copies are only made of what the policy keeps
+Mesh::Mesh(const MeshArrays& arrays, Residency policy, VertexFormat format)
+	: nverts(arrays.nverts), ntris(arrays.ntris), format(format)
 {
-	this->vertices = {};
-	this->indices = {};
-	this->indicesAdjacency = {};
+	setupMesh(arrays);
 
-	VAO = 0;
-	VBO = 0;
-	EBO = 0;
+	if (policy != Residency::ReleaseAll) {
+		// Needed on the CPU for the connectivity
+		vertices.assign(arrays.vertices, arrays.vertices + nverts);
+		indices.assign(arrays.indices, arrays.indices + 3 * ntris);
+	}
+	if (policy == Residency::KeepAll) {
+		if (arrays.adjacency) indicesAdjacency.assign(arrays.adjacency, arrays.adjacency + 6 * ntris);
+		if (arrays.edges) indicesEdgeList.assign(arrays.edges, arrays.edges + 4 * nedges);
+	}
+
+	setResidency(policy);
 }
 
 // render the mesh
-void Mesh::render()
+// Every draw mode has its own index buffer. The VAOs hold the triangle index buffer,
+// so the other buffers are bound only for the duration of the draw call.
+void Mesh::render(DrawMode mode, VertexStream stream)
 {
-	glBindVertexArray(VAO);
-
-	if (adjacency) {
-		glDrawElements(GL_TRIANGLES_ADJACENCY, indicesAdjacency.size(), GL_UNSIGNED_INT, 0);
-	} else {
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	GLenum primitive = GL_TRIANGLES;
+	GLuint ebo = EBO;
+	GLsizei count = GLsizei(3 * ntris);
+
+	if (mode == DrawMode::Adjacency) {
+		primitive = GL_TRIANGLES_ADJACENCY;
+		ebo = adjacencyEBO;
+		count = GLsizei(6 * ntris);
+	} else if (mode == DrawMode::Edges) {
+		primitive = GL_LINES_ADJACENCY;
+		ebo = edgeEBO;
+		count = GLsizei(4 * nedges);
 	}
 
+	if (ebo == 0) return; // Index buffer for this mode not created
+
+	glBindVertexArray(stream == VertexStream::PositionOnly ? positionVAO : VAO);
+
+	// Constant attributes for decoding the vertices. They are not part of the VAO state
+	glVertexAttrib4f(DECODE_SCALE_LOCATION, decodeScale.x, decodeScale.y, decodeScale.z, decodeScale.w);
+	glVertexAttrib3f(DECODE_OFFSET_LOCATION, decodeOffset.x, decodeOffset.y, decodeOffset.z);
+
+	if (ebo != EBO) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glDrawElements(primitive, count, indexType, 0);
+	if (ebo != EBO) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
 	glBindVertexArray(0);
 }
 
-// use adjacency information to render the triangle
+// Generate adjacency information and upload it to its own index buffer
 void Mesh::useAdjacency()
 {
-	if ( adjacency ) return; // Adjency already enabled
+	if ( adjacencyEBO != 0 ) return; // Adjency already enabled
 
 	if ( indicesAdjacency.empty() ) genAdjacencyInfo();
+	if ( indicesAdjacency.empty() ) return; // No data left to generate it from
 
-	// Update buffers
-	setupMesh();
+	uploadIndexBuffer(adjacencyEBO, indicesAdjacency.data(), indicesAdjacency.size());
+	if ( residency != Residency::KeepAll ) releaseVector(indicesAdjacency);
 }
 
-void Mesh::disableAdjacency()
+// Generate the edge list used to render shadow volumes with one primitive per unique edge
+void Mesh::useEdgeList()
 {
-	adjacency = false;
+	if ( edgeEBO != 0 ) return; // Edge list already created
+
+	genHalfEdgeMesh();
+	if ( halfEdgeMesh.empty() ) return; // No data left to generate it from
+
+	halfEdgeMesh.genEdgeListIndices(indicesEdgeList);
+	nedges = GLuint(indicesEdgeList.size() / 4);
+
+	uploadIndexBuffer(edgeEBO, indicesEdgeList.data(), indicesEdgeList.size());
+	if ( residency != Residency::KeepAll ) releaseVector(indicesEdgeList);
 }
 
-// Initializes all the buffer objects/arrays
-void Mesh::setupMesh()
+// Release the CPU-side copies that the residency policy does not keep
+void Mesh::setResidency(Residency policy)
 {
-	// Create buffers/arrays
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	residency = policy;
+	if (policy == Residency::KeepAll) return;
 
-	glBindVertexArray(VAO);
-	// Load data into vertex buffers
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	// A great thing about structs is that their memory layout is sequential for all its items.
-	// => can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-	// again translates to 3/2 floats which translates to a byte array.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	// Index buffer, with or without adjacency information
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if (policy == Residency::KeepConnectivity) {
+		genHalfEdgeMesh();
+	} else {
+		halfEdgeMesh.clear();
+	}
+
+	releaseVector(vertices);
+	releaseVector(indices);
+	releaseVector(indicesAdjacency);
+	releaseVector(indicesEdgeList);
+}
+
+// Print the bytes held by the mesh on the CPU and on the GPU
+void Mesh::reportMemory(const std::string& name) const
+{
+	size_t cpuVertices = vertices.capacity() * sizeof(Vertex);
+	size_t cpuIndices = (indices.capacity() + indicesAdjacency.capacity() + indicesEdgeList.capacity()) * sizeof(GLuint);
+	size_t cpuConnectivity = halfEdgeMesh.memoryBytes();
+
+	size_t gpuVertices = (VBO != 0 ? nverts * vertexSize : 0) + (positionVBO != 0 ? nverts * positionSize : 0);
+	size_t gpuIndices = ((EBO != 0 ? 3 * ntris : 0) + (adjacencyEBO != 0 ? 6 * ntris : 0) + (edgeEBO != 0 ? 4 * nedges : 0)) * indexSize;
+
+	std::cout << "Mesh memory \"" << name << "\": " << nverts << " vertices, " << ntris << " triangles\n"
+		<< "  CPU: " << cpuVertices << " B vertices, " << cpuIndices << " B indices, " << cpuConnectivity << " B half-edge mesh, "
+		<< (cpuVertices + cpuIndices + cpuConnectivity) << " B total\n"
+		<< "  GPU: " << gpuVertices << " B vertices, " << gpuIndices << " B indices, "
+		<< (gpuVertices + gpuIndices) << " B total" << std::endl;
+}
 
-	if (adjacency) {
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesAdjacency.size() * sizeof(GLuint), &indicesAdjacency[0], GL_STATIC_DRAW);
+// Upload indices to a separate index buffer, created if needed. The copy target is used
+// for the upload so the element buffer bound to the VAOs is left untouched.
+// 16-bit indices are narrowed straight into the mapped buffer
+void Mesh::uploadIndexBuffer(GLBuffer& buffer, const GLuint* data, size_t count)
+{
+	if (buffer == 0) buffer = GLBuffer::create();
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (indexType == GL_UNSIGNED_SHORT) {
+		fillBuffer(GL_COPY_WRITE_BUFFER, count * sizeof(GLushort), [&](unsigned char* out) {
+			GLushort* shortIndices = reinterpret_cast<GLushort*>(out);
+			for (size_t i = 0; i < count; i++)
+			{
+				shortIndices[i] = GLushort(data[i]);
+			}
+		});
 	} else {
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+		glBufferData(GL_COPY_WRITE_BUFFER, count * sizeof(GLuint), data, GL_STATIC_DRAW);
 	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
 
-	// set the vertex attribute pointers
-	// vertex Positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	// vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-	// vertex texture coords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+// Vertex data that is already in a layout, which is uploaded as is instead of being encoded
+template <typename L>
+static const void* layoutData(const MeshArrays&) { return nullptr; }
 
-	glBindVertexArray(0);
+template <>
+const void* layoutData<FloatLayout>(const MeshArrays& arrays) { return arrays.vertices; }
+
+template <>
+const void* layoutData<FloatPositionLayout>(const MeshArrays& arrays) { return arrays.positions; }
+
+// Encode the vertices into a layout and upload them to the buffer bound to GL_ARRAY_BUFFER
+template <typename L>
+static void uploadLayout(const MeshArrays& arrays, const VertexEncoding& encoding)
+{
+	const void* data = layoutData<L>(arrays);
+	if (data) {
+		glBufferData(GL_ARRAY_BUFFER, arrays.nverts * L::stride, data, GL_STATIC_DRAW);
+		return;
+	}
+
+	// Encoded in place, each thread writing a contiguous range of the mapping
+	fillBuffer(GL_ARRAY_BUFFER, arrays.nverts * L::stride, [&](unsigned char* out) {
+		Parallel::forChunks(arrays.nverts, Parallel::numThreads(), [&](size_t begin, size_t end, unsigned) {
+			L::encode(arrays.vertices + begin, end - begin, encoding, out + begin * L::stride);
+		});
+	});
 }
 
-// Create the data structures used for rendering triangles with adjacency info
-void Mesh::genAdjacencyInfo()
+// Upload the vertex streams in the given layouts
+// Quantized layouts store positions relative to the bounds, and render passes
+// the decode offset and scale back to the shaders
+template <typename FullLayout, typename PositionLayout>
+void Mesh::uploadVertices(const MeshArrays& arrays)
 {
-	std::vector<GLuint> newIndices(6 * ntris);
+	static_assert((FullLayout::flags & QUANTIZED_POSITIONS) == (PositionLayout::flags & QUANTIZED_POSITIONS),
+		"both streams must decode positions the same way");
+	const bool shared = std::is_same<FullLayout, PositionLayout>::value;
 
-	// Generate map that maps each vertex position to a unique index
-	genUniqueIndexMap();
+	VertexEncoding encoding(arrays.bounds);
 
-	for (int i = 0; i < ntris; i++)
-	{
-		GLuint firstIdx = 3 * i; // The first index of the triangle in the index array
-		GLuint newFirstIdx = 6 * i;
-
-		// Get unique index for each vertex in the triangle
-		GLuint v[3];
-		for (int j = 0; j < 3; j++)
-		{
-			GLuint idx = indices[firstIdx + j];
-			v[j] = posIndexMap[vertices[idx].Position];
-		}
-
-		// Create new indexes to be used for adjacency mode
-		for (int j = 0; j < 3; j++)
-		{
-			// Original vertice stays the same 
-			newIndices[newFirstIdx + 2*j] = indices[firstIdx + j];
-
-			// Find and add neighboring vertice to list
-			GLuint n = findAdjacentVertexIdx(v[j], v[(j + 1) % 3], v[(j + 2) % 3]);
-			assert(n != -1);
-			newIndices[newFirstIdx + 2 * j + 1] = n;
-		}
+	positionVBO = GLBuffer::create();
+	glBindVertexArray(positionVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	uploadLayout<PositionLayout>(arrays, encoding);
+	PositionLayout::setupAttributes();
+
+	glBindVertexArray(VAO);
+	if (shared) {
+		VBO = GLBuffer();
+		glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	} else {
+		VBO = GLBuffer::create();
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		uploadLayout<FullLayout>(arrays, encoding);
 	}
+	FullLayout::setupAttributes();
+
+	glBindVertexArray(0);
 
-	adjacency = true;
-	indicesAdjacency = newIndices;
+	vertexSize = shared ? 0 : FullLayout::stride;
+	positionSize = PositionLayout::stride;
+	decodeScale = FullLayout::decodeScale(encoding);
+	decodeOffset = FullLayout::decodeOffset(encoding);
 }
 
-// Create map of unique vertice indexes, to use for adjacency information generation
-// If a position vector is duplicated in the VB we only want the index of the first occurrence
-void Mesh::genUniqueIndexMap()
+// Initializes all the buffer objects/arrays
+// Adjacency and edge list buffers are created as well if the arrays hold them
+void Mesh::setupMesh(const MeshArrays& arrays)
 {
-	for (int i = 0; i < ntris; i++)
-	{
-		int firstIdx = 3 * i; // The first index of the triangle in the index array
+	bounds = arrays.bounds;
 
-		// For each vertex position, check if in the map.
-		// If not, add it and the current index. 
-		for (int j = 0; j < 3; j++)
-		{
-			int idx = indices[firstIdx + j];
-			glm::vec3 pos = vertices[idx].Position;
+	// 16-bit indices when every vertex can be addressed with them
+	indexType = arrays.nverts <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
 
-			if (posIndexMap.find(pos) == posIndexMap.end()) {
-				posIndexMap[pos] = idx;
-			}
-		}
+	// Create buffers/arrays. Any previous objects are deleted by their handles
+	VAO = GLVertexArray::create();
+	positionVAO = GLVertexArray::create();
+
+	// Triangle index buffer, shared by both streams. Adjacency and edge list indices are kept in their own buffers
+	uploadIndexBuffer(EBO, arrays.indices, 3 * size_t(arrays.ntris));
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBindVertexArray(positionVAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBindVertexArray(0);
+
+	if (arrays.adjacency) uploadIndexBuffer(adjacencyEBO, arrays.adjacency, 6 * arrays.ntris);
+	if (arrays.edges) {
+		nedges = arrays.nedges;
+		uploadIndexBuffer(edgeEBO, arrays.edges, 4 * nedges);
+	}
+
+	// Vertex buffers and attribute pointers. The float layouts are uploaded straight from the arrays
+	switch (format) {
+	case VertexFormat::Compact:
+		uploadVertices<CompactLayout, CompactPositionLayout>(arrays);
+		break;
+	case VertexFormat::PositionOnly:
+		uploadVertices<FloatPositionLayout, FloatPositionLayout>(arrays);
+		break;
+	default:
+		uploadVertices<FloatLayout, FloatPositionLayout>(arrays);
+		break;
 	}
 }
 
-// Find the neighboring vertex index of the edge given by startIdx and endIdx
-// that differes from oppIdx. 
-// OBS! Assumes same index for all vertices with same position
-int Mesh::findAdjacentVertexIdx(GLuint startIdx, GLuint endIdx, GLuint oppIdx)
+// Create the data structures used for rendering triangles with adjacency info
+// The adjacency indices are read from the half-edge mesh, which is built in linear time.
+void Mesh::genAdjacencyInfo()
 {
-	//cout << "Edge given by: " << startIdx << " " << endIdx << endl;
+	genHalfEdgeMesh();
+	halfEdgeMesh.genAdjacencyIndices(indicesAdjacency);
+}
 
-	for (int i = 0; i < ntris; i++)
-	{
-		int firstIdx = 3 * i;
-
-		// Get the unique indices for the vertices
-		GLuint faceIndices[3];
-		for (int j = 0; j < 3; j++)
-		{
-			GLuint idx = indices[firstIdx + j];
-			faceIndices[j] = posIndexMap[vertices[idx].Position];
-		}
-
-		// For each edge in the triangle, check its opposite vertice
-		for (int edge = 0; edge < 3; edge++)
-		{
-			GLuint v0 = faceIndices[edge];
-			GLuint v1 = faceIndices[(edge + 1) % 3];
-			GLuint v2 = faceIndices[(edge + 2) % 3]; // Opposite index to side being tested
-
-			if ((v0 == startIdx && v1 == endIdx) || (v1 == startIdx && v0 == endIdx))
-			{
-				// If last index is not the opposite of the edge we are comparing with
-				// => we have found the adjacent vertex.
-				if (v2 != oppIdx) return v2;
-			}
-		}
+// Build the half-edge mesh, if not already done
+void Mesh::genHalfEdgeMesh()
+{
+	if (!halfEdgeMesh.empty() || indices.empty()) return;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	halfEdgeMesh.build(vertices, indices);
+
+	adjacencyMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+// Print the connectivity of the mesh and the time it took to build
+void Mesh::reportAdjacency(const std::string& name) const
+{
+	if (halfEdgeMesh.empty()) {
+		std::cout << "Mesh adjacency \"" << name << "\": no connectivity is held" << std::endl;
+		return;
+	}
+
+	std::cout << "Mesh adjacency \"" << name << "\": " << ntris << " triangles, "
+		<< halfEdgeMesh.numEdges() << " unique edges (" << halfEdgeMesh.numBoundaryEdges() << " boundary, "
+		<< halfEdgeMesh.numNonManifoldEdges() << " non-manifold), built in " << adjacencyMilliseconds << " ms on "
+		<< Parallel::numThreads() << " threads" << std::endl;
+}
+
+// Time the adjacency generation with different thread counts
+void Mesh::reportAdjacencyScaling()
+{
+	if (indices.empty()) {
+		std::cout << "reportAdjacencyScaling: vertex data has been released" << std::endl;
+		return;
 	}
 
-	return 0;// -1; // no neighbor found
-}
\ No newline at end of file
+	HalfEdgeMesh::reportBuildScaling(vertices, indices);
+}
@@ -1,6 +1,7 @@
 /*
  *	Class for handling mesh information, like vetrices, indices and texture coordinates.
- *	Also includes a basic generation of adjacency information for each vertex, if that information is required.
+ *	Also includes generation of adjacency information for each vertex, if that information is required,
+ *	using a half-edge representation of the mesh.
  *
  *	Author: Emma Broman 
  */
@@ -12,37 +13,17 @@
 #include <glm/glm.hpp>
 
 #include "Shader.h"
+#include "HalfEdgeMesh.h"
+#include "GLHandle.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
-#include <map>
 
 const glm::vec3 ZERO(0.0f, 0.0f, 0.0f);
 
-// Methods to compare glm::vec3 (needed for map)
-struct CompVectors
-{
-	bool operator()(const glm::vec3& a, const glm::vec3& b)const {
-		if (a.x < b.x) {
-			return true;
-		}
-		else if (a.x == b.x) {
-			if (a.y < b.y) {
-				return true;
-			}
-			else if (a.y == b.y) {
-				if (a.z < b.z) {
-					return true;
-				}
-			}
-		}
-		return false;
-	}
-};
-
 // Helper structure for vertex information
 struct Vertex {
 	// position
@@ -56,54 +37,169 @@ struct Vertex {
 		: Position(p), Normal(n), TexCoords(tc) {}
 };
 
+// Axis-aligned bounding box in model space
+struct Bounds {
+	glm::vec3 min = ZERO;
+	glm::vec3 max = ZERO;
+};
+
+// Bounding box of the positions of the given vertices
+Bounds computeBounds(const Vertex* vertices, size_t count);
+
+// Pointers to the arrays of a mesh, for uploading data that is not held in vectors (e.g. a mapped file).
+// Optional arrays are null when not available
+struct MeshArrays {
+	const Vertex* vertices = nullptr;		// nverts vertices
+	const glm::vec3* positions = nullptr;	// nverts positions (optional)
+	const GLuint* indices = nullptr;		// 3 * ntris triangle indices
+	const GLuint* adjacency = nullptr;		// 6 * ntris triangle adjacency indices (optional)
+	const GLuint* edges = nullptr;			// 4 * nedges edge list indices (optional)
+	GLuint nverts = 0;
+	GLuint ntris = 0;
+	GLuint nedges = 0;
+	Bounds bounds;
+};
+
 struct Texture {
 	GLuint id;
 	std::string type;
 	std::string path;
 };
 
+// The vertex stream used when rendering a mesh
+enum class VertexStream {
+	Full,			// position, normal and texture coordinates
+	PositionOnly	// tightly packed positions, for passes that only read aPos
+};
+
+// The format of the vertex buffers of a mesh on the GPU. Each format is a pair of layouts, see VertexLayout.h
+enum class VertexFormat {
+	Float,			// 32-bit float attributes: 32 bytes per vertex, 12 in the position-only stream
+	Compact,		// 16-bit normalized positions relative to the bounds, octahedral 16-bit normals and
+					// half float texture coordinates: 16 bytes per vertex, 8 in the position-only stream
+	PositionOnly	// float positions only, shared by both streams: 12 bytes per vertex. For meshes
+					// that are only drawn by passes reading aPos, like occluders and light markers
+};
+
+// Generic attribute locations that hold the same value for the whole mesh, set by Mesh::render.
+// Vertex shaders decode positions as aDecodeOffset + aDecodeScale.xyz * aPos, and normals are
+// octahedral if aDecodeScale.w is 1
+const GLuint DECODE_SCALE_LOCATION = 3;
+const GLuint DECODE_OFFSET_LOCATION = 4;
+
+// The primitives and index buffer used when rendering a mesh
+enum class DrawMode {
+	Triangles,	// GL_TRIANGLES, 3 indices per face
+	Adjacency,	// GL_TRIANGLES_ADJACENCY, 6 indices per face (requires useAdjacency)
+	Edges		// GL_LINES_ADJACENCY, 4 indices per unique edge (requires useEdgeList)
+};
+
+// Which CPU-side copies a mesh keeps after its data has been uploaded to the GPU
+enum class Residency {
+	KeepAll,			// keep all vertices, indices and connectivity (default)
+	KeepConnectivity,	// keep only the half-edge mesh, as needed for CPU silhouette and culling queries
+	ReleaseAll			// keep nothing on the CPU, the mesh can only be rendered
+};
+
 class Mesh {
 public:
-	// constructor 
-	Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, GLuint ntris);
+	// constructor, uploading the vertices in the given format
+	Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, GLuint ntris, VertexFormat format = VertexFormat::Float);
+
+	// constructor uploading straight from the given arrays. Only the CPU-side copies
+	// that the residency policy keeps are made
+	Mesh(const MeshArrays& arrays, Residency policy, VertexFormat format = VertexFormat::Float);
 
 	// default constructor - only used for memory allocation 
-	Mesh();
+	Mesh() = default;
+
+	// meshes own their GL objects, so they can be moved but not copied
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
 
-	// render the mesh 
-	void render();
+	// render the mesh with the given primitives, using either all vertex attributes or only the positions
+	void render(DrawMode mode = DrawMode::Triangles, VertexStream stream = VertexStream::Full);
 
-	// use adjacency information to render the triangle
+	// generate adjacency information, which enables DrawMode::Adjacency
 	void useAdjacency();
 
-	// disable adjacency mode 
-	void disableAdjacency();
+	// generate the edge list used to render shadow volumes with one primitive per unique edge,
+	// which enables DrawMode::Edges. Each edge is (start, end, opposite0, opposite1)
+	void useEdgeList();
+
+	// release the CPU-side copies that the residency policy does not keep. 
+	// Connectivity is built before the vertices are released if the policy keeps it.
+	void setResidency(Residency policy);
+
+	// print the bytes held by the mesh on the CPU and on the GPU
+	void reportMemory(const std::string& name) const;
+
+	// print how the adjacency generation scales with the number of threads
+	void reportAdjacencyScaling();
+
+	// bounding box of the vertex positions
+	const Bounds& getBounds() const { return bounds; }
+
+	// format of the vertex buffers on the GPU
+	VertexFormat getVertexFormat() const { return format; }
+
+	// connectivity of the mesh, available once adjacency has been used
+	const HalfEdgeMesh& getHalfEdgeMesh() const { return halfEdgeMesh; }
+
+	// Print the size of the adjacency information and the time taken to generate it
+	void reportAdjacency(const std::string& name) const;
 
 private:
 	//  Mesh Data  
 	std::vector<Vertex> vertices;
 	std::vector<GLuint> indices;
-	GLuint VAO;
-	GLuint ntris; // The number of triangles/faces
+	GLuint nverts = 0; // The number of vertices
+	GLuint ntris = 0; // The number of triangles/faces
+	Residency residency = Residency::KeepAll;
+	Bounds bounds;
+
+	// GPU data format
+	VertexFormat format = VertexFormat::Float;
+	GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT when all vertices can be indexed with 16 bits
+	size_t indexSize = sizeof(GLuint);
+	size_t vertexSize = sizeof(Vertex), positionSize = sizeof(glm::vec3); // Bytes per vertex in each stream
+	glm::vec4 decodeScale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+	glm::vec3 decodeOffset = ZERO;
 
 	// Render data  
-	GLuint VBO, EBO;
+	GLVertexArray VAO;
+	GLBuffer VBO, EBO;
+	GLVertexArray positionVAO; // Position-only stream, sharing the index buffer
+	GLBuffer positionVBO;
 
 	// Adjacency data
-	bool adjacency = false;
 	std::vector<GLuint> indicesAdjacency;
-	std::map<glm::vec3, GLuint, CompVectors> posIndexMap; // Maps one unique index for every vertex position vector
+	GLBuffer adjacencyEBO;
+	HalfEdgeMesh halfEdgeMesh; // Welded connectivity used to generate the adjacency indices
+	double adjacencyMilliseconds = 0.0; // Time taken to generate the adjacency information, 0 if it was loaded
+
+	// Edge list data: 4 indices per unique edge. The caps are drawn from the triangle indices
+	std::vector<GLuint> indicesEdgeList;
+	GLuint nedges = 0;
+	GLBuffer edgeEBO;
 
 	// initializes all the buffer objects/arrays 
-	void setupMesh();
+	void setupMesh(const MeshArrays& arrays);
+
+	// upload indices to a separate index buffer, created if needed, converting them to the index type
+	void uploadIndexBuffer(GLBuffer& buffer, const GLuint* data, size_t count);
+
+	// encode the vertices into the layouts of the full and the position-only streams and upload them.
+	// Both streams share one buffer when the layouts are the same
+	template <typename FullLayout, typename PositionLayout>
+	void uploadVertices(const MeshArrays& arrays);
 
 	// Create the data structures used for rendering triangles with adjacency info
 	void genAdjacencyInfo();
 
-	// Create map of unique vertice indexes, to use for adjacency information generation
-	void genUniqueIndexMap();
-
-	// find index of neighbor vertex to the edge (startIdx -> endIdx) 
-	int findAdjacentVertexIdx(GLuint startIdx, GLuint endIdx, GLuint oppIdx);
+	// Build the half-edge mesh, if not already done
+	void genHalfEdgeMesh();
 };
 #endif
\ No newline at end of file
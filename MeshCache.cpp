@@ -0,0 +1,200 @@
+#include "MeshCache.h"
+#include "HalfEdgeMesh.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+const uint32_t MeshCache::VERSION;
+
+static const char MAGIC[4] = { 'M', 'E', 'S', 'H' };
+
+// ***************************************************************************
+// * PUBLIC
+// ***************************************************************************
+
+std::string MeshCache::cachePath(const char* sourcePath)
+{
+	return std::string(sourcePath) + ".mesh";
+}
+
+bool MeshCache::write(const char* path, const char* sourcePath, float weldEpsilon,
+	const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	// The same processing as Mesh::useAdjacency and Mesh::useEdgeList
+	HalfEdgeMesh halfEdgeMesh(vertices, indices);
+	std::vector<GLuint> adjacency, edges;
+	halfEdgeMesh.genAdjacencyIndices(adjacency);
+	halfEdgeMesh.genEdgeListIndices(edges);
+
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		positions[i] = vertices[i].Position;
+	}
+
+	MeshArrays arrays;
+	arrays.vertices = vertices.data();
+	arrays.positions = positions.data();
+	arrays.indices = indices.data();
+	arrays.adjacency = adjacency.data();
+	arrays.edges = edges.data();
+	arrays.nverts = GLuint(vertices.size());
+	arrays.ntris = GLuint(indices.size() / 3);
+	arrays.nedges = GLuint(edges.size() / 4);
+	arrays.bounds = computeBounds(vertices.data(), vertices.size());
+
+	return write(path, sourcePath, weldEpsilon, arrays);
+}
+
+bool MeshCache::write(const char* path, const char* sourcePath, float weldEpsilon, const MeshArrays& arrays)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	Header header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.nverts = arrays.nverts;
+	header.ntris = arrays.ntris;
+	header.nedges = arrays.nedges;
+	header.weldEpsilon = weldEpsilon;
+	if (sourcePath) sourceStamp(sourcePath, header.sourceSize, header.sourceTime);
+
+	for (int k = 0; k < 3; k++)
+	{
+		header.boundsMin[k] = arrays.bounds.min[k];
+		header.boundsMax[k] = arrays.bounds.max[k];
+	}
+
+	const size_t nverts = arrays.nverts, ntris = arrays.ntris, nedges = arrays.nedges;
+
+	FILE* out = fopen(path, "wb");
+	if (!out) {
+		fprintf(stderr, "%s: %s\n", "Could not write mesh cache", path);
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	ok = ok && fwrite(arrays.vertices, sizeof(Vertex), nverts, out) == nverts;
+	ok = ok && fwrite(arrays.positions, sizeof(glm::vec3), nverts, out) == nverts;
+	ok = ok && fwrite(arrays.indices, sizeof(GLuint), 3 * ntris, out) == 3 * ntris;
+	ok = ok && fwrite(arrays.adjacency, sizeof(GLuint), 6 * ntris, out) == 6 * ntris;
+	ok = ok && fwrite(arrays.edges, sizeof(GLuint), 4 * nedges, out) == 4 * nedges;
+	ok = (fclose(out) == 0) && ok;
+
+	if (!ok) {
+		fprintf(stderr, "%s: %s\n", "Could not write mesh cache", path);
+		remove(path);
+		return false;
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> writeTime = endTime - startTime;
+	printf("MeshCache: wrote \"%s\" (%u vertices, %u triangles, %u edges) in %.2f ms\n",
+		path, header.nverts, header.ntris, header.nedges, writeTime.count());
+
+	return true;
+}
+
+bool MeshCache::open(const char* path, const char* sourcePath, float weldEpsilon)
+{
+	close();
+	if (!file.open(path)) return false;
+
+	Header header;
+	if (file.size() < sizeof(header)) {
+		close();
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.vertexSize != sizeof(Vertex)) {
+		printf("MeshCache: \"%s\" has an old or unknown format, ignoring it\n", path);
+		close();
+		return false;
+	}
+
+	if (sourcePath) {
+		uint64_t sourceSize = 0;
+		int64_t sourceTime = 0;
+		if (!sourceStamp(sourcePath, sourceSize, sourceTime) || sourceSize != header.sourceSize
+			|| sourceTime != header.sourceTime || weldEpsilon != header.weldEpsilon) {
+			printf("MeshCache: \"%s\" is out of date, ignoring it\n", path);
+			close();
+			return false;
+		}
+	}
+
+	const uint64_t nverts = header.nverts, ntris = header.ntris, nedges = header.nedges;
+	const uint64_t expectedSize = sizeof(header) + nverts * (sizeof(Vertex) + sizeof(glm::vec3))
+		+ (3 * ntris + 6 * ntris + 4 * nedges) * sizeof(GLuint);
+	if (file.size() != expectedSize) {
+		printf("MeshCache: \"%s\" is truncated, ignoring it\n", path);
+		close();
+		return false;
+	}
+
+	// The sections follow the header in order. All sizes are multiples of 4 bytes, so every section is aligned
+	const char* p = file.data() + sizeof(header);
+	meshArrays.vertices = reinterpret_cast<const Vertex*>(p);
+	p += nverts * sizeof(Vertex);
+	meshArrays.positions = reinterpret_cast<const glm::vec3*>(p);
+	p += nverts * sizeof(glm::vec3);
+	meshArrays.indices = reinterpret_cast<const GLuint*>(p);
+	p += 3 * ntris * sizeof(GLuint);
+	meshArrays.adjacency = reinterpret_cast<const GLuint*>(p);
+	p += 6 * ntris * sizeof(GLuint);
+	meshArrays.edges = reinterpret_cast<const GLuint*>(p);
+
+	meshArrays.nverts = header.nverts;
+	meshArrays.ntris = header.ntris;
+	meshArrays.nedges = header.nedges;
+	meshArrays.bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	meshArrays.bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+	return true;
+}
+
+void MeshCache::close()
+{
+	file.close();
+	meshArrays = MeshArrays();
+}
+
+// ***************************************************************************
+// * PRIVATE
+// ***************************************************************************
+
+// The time has the finest resolution the file system keeps, so that a source rewritten within the
+// same second as the cache still invalidates it
+bool MeshCache::sourceStamp(const char* path, uint64_t& size, int64_t& time)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) return false;
+
+	size = (uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+	time = int64_t((uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime); // 100 ns ticks
+#else
+	struct stat info;
+	if (stat(path, &info) != 0) return false;
+
+	size = uint64_t(info.st_size);
+#ifdef __APPLE__
+	const struct timespec& modified = info.st_mtimespec;
+#else
+	const struct timespec& modified = info.st_mtim;
+#endif
+	time = int64_t(modified.tv_sec) * 1000000000 + modified.tv_nsec; // Nanoseconds
+#endif
+	return true;
+}
@@ -0,0 +1,72 @@
+/*
+ *	Versioned binary cache of a processed mesh, stored next to its source file.
+ *	The file holds the vertex streams, the triangle, adjacency and edge list indices and the bounds,
+ *	laid out so that the mapped file can be uploaded to GL buffers without any intermediate copies.
+ *
+ *	Layout (native byte order): Header, then nverts Vertex, nverts positions, 3 * ntris triangle indices,
+ *	6 * ntris adjacency indices and 4 * nedges edge list indices.
+ */
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "Mesh.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MeshCache {
+public:
+	// Increase when the layout or the processing changes, so old caches are rebuilt
+	static const uint32_t VERSION = 2;
+
+	MeshCache() = default;
+
+	// Path of the cache file for a source file
+	static std::string cachePath(const char* sourcePath);
+
+	// Generate the adjacency and edge list indices, position stream and bounds of an indexed mesh and write
+	// them to a cache file. The source file (if any) is stamped into the cache to detect stale caches later
+	static bool write(const char* path, const char* sourcePath, float weldEpsilon,
+		const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+	// Write already processed arrays to a cache file. All arrays must be present
+	static bool write(const char* path, const char* sourcePath, float weldEpsilon, const MeshArrays& arrays);
+
+	// Map a cache file and check that it is complete, of this version and up to date with the
+	// source file and welding. Pass no source file to skip the staleness check
+	bool open(const char* path, const char* sourcePath = nullptr, float weldEpsilon = 0.0f);
+
+	// unmap the cache file
+	void close();
+
+	bool isOpen() const { return file.isOpen(); }
+
+	// Arrays pointing into the mapped file, valid while the cache is open
+	const MeshArrays& arrays() const { return meshArrays; }
+
+private:
+	struct Header {
+		char magic[4];			// "MESH"
+		uint32_t version;		// VERSION
+		uint32_t vertexSize;	// sizeof(Vertex), guards against layout changes
+		uint32_t nverts;
+		uint32_t ntris;
+		uint32_t nedges;
+		uint64_t sourceSize;	// Size and modification time of the source file when the cache was written
+		int64_t sourceTime;		// In the file system's finest unit (nanoseconds, or 100 ns ticks on Windows)
+		float weldEpsilon;		// Welding used when the cache was written
+		float boundsMin[3];
+		float boundsMax[3];
+		uint32_t reserved;		// Keeps the header size a multiple of 8 bytes
+	};
+
+	MappedFile file;
+	MeshArrays meshArrays;
+
+	// Size and sub-second modification time of a file. Returns false if the file does not exist
+	static bool sourceStamp(const char* path, uint64_t& size, int64_t& time);
+};
+#endif
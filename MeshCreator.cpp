@@ -1,4 +1,9 @@
 #include "MeshCreator.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "SurfaceDistance.h"
 
 /*
  * printError() - Signal an error.
@@ -9,8 +14,32 @@ void printError(const char *errtype, const char *errmsg)
 	fprintf(stderr, "%s: %s\n", errtype, errmsg);
 }
 
+/* Storage shared by all generated meshes that are only kept on the GPU */
+StagingArena& MeshCreator::staging()
+{
+	static StagingArena arena;
+	return arena;
+}
+
+/* Create a mesh that takes over or uploads from the generated vectors */
+Mesh MeshCreator::createMesh(vector<Vertex>& vertices, vector<GLuint>& indices, Residency residency, VertexFormat format)
+{
+	GLuint ntris = GLuint(indices.size() / 3);
+	if (residency == Residency::KeepAll) {
+		return Mesh(std::move(vertices), std::move(indices), ntris, format);
+	}
+
+	MeshArrays arrays;
+	arrays.vertices = vertices.data();
+	arrays.indices = indices.data();
+	arrays.nverts = GLuint(vertices.size());
+	arrays.ntris = ntris;
+	arrays.bounds = computeBounds(arrays.vertices, arrays.nverts);
+	return Mesh(arrays, residency, format);
+}
+
 /* Create a simple triangle */
-Mesh MeshCreator::createTriangle()
+Mesh MeshCreator::createTriangle(VertexFormat format)
 {
 	vector<Vertex> vertices{
 		Vertex(glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, 0.0f)),
@@ -22,14 +51,13 @@ Mesh MeshCreator::createTriangle()
 		0,1,2
 	};
 
-	return Mesh(vertices, indices, 1);
+	return Mesh(std::move(vertices), std::move(indices), 1, format);
 }
 
 /* Create a box with the dimension xsize * ysize * zsize */
-Mesh MeshCreator::createBox(float xsize, float ysize, float zsize)
+Mesh MeshCreator::createBox(float xsize, float ysize, float zsize, Residency residency, VertexFormat format)
 {
 	const int nverts = 24;
-	const int ntris = 12;
 
 	const GLfloat vertices_data[8 * nverts] =
 	{
@@ -67,7 +95,11 @@ Mesh MeshCreator::createBox(float xsize, float ysize, float zsize)
 		-xsize, -ysize, -zsize,   0.0f, 0.0f, -1.0f,   1.0f, 0.0f
 	};
 
-	vector<Vertex> vertices(nverts);
+	vector<Vertex> ownedVertices;
+	vector<GLuint> ownedIndices;
+	vector<Vertex>& vertices = residency == Residency::KeepAll ? ownedVertices : staging().vertices();
+	vector<GLuint>& indices = residency == Residency::KeepAll ? ownedIndices : staging().indices();
+	vertices.resize(nverts);
 
 	for (int i = 0; i < nverts; i++)
 	{
@@ -88,7 +120,7 @@ Mesh MeshCreator::createBox(float xsize, float ysize, float zsize)
 		vertices[i] = Vertex{ position, normal, texCoords };
 	}
 
-	vector<unsigned int> indices{
+	indices.assign({
 
 		0,3,6,		// Face 1 - right
 		0,6,9,
@@ -107,9 +139,9 @@ Mesh MeshCreator::createBox(float xsize, float ysize, float zsize)
 
 		5,23,20,	// Face 6 - back
 		5,20,8
-	};
+	});
 
-	return Mesh(vertices, indices, ntris);
+	return createMesh(vertices, indices, residency, format);
 }
 
 /*
@@ -130,7 +162,19 @@ Mesh MeshCreator::createBox(float xsize, float ysize, float zsize)
  *
  * Modified by Emma Broman 2018 to work with the Mesh class used in this project. 
  */
-Mesh MeshCreator::createSphere(float radius, int segments) {
+Mesh MeshCreator::createSphere(float radius, int segments, Residency residency, VertexFormat format) {
+
+	vector<Vertex> ownedVertices;
+	vector<GLuint> ownedIndices;
+	vector<Vertex>& vertices = residency == Residency::KeepAll ? ownedVertices : staging().vertices();
+	vector<GLuint>& indices = residency == Residency::KeepAll ? ownedIndices : staging().indices();
+	generateSphere(radius, segments, vertices, indices);
+
+	return createMesh(vertices, indices, residency, format);
+}
+
+/* Generate the sphere of createSphere without uploading it */
+void MeshCreator::generateSphere(float radius, int segments, vector<Vertex>& vertices, vector<GLuint>& indices) {
 
 	int i, j, base, i0;
 	float x, y, z, R;
@@ -144,8 +188,8 @@ Mesh MeshCreator::createSphere(float radius, int segments) {
 	nverts = 1 + (vsegs - 1) * (hsegs + 1) + 1; // top + middle + bottom
 	ntris = hsegs + (vsegs - 2) * hsegs * 2 + hsegs; // top + middle + bottom
 
-	vector<Vertex> vertices(nverts);
-	vector<unsigned int> indices(ntris * 3);
+	vertices.resize(nverts);
+	indices.resize(ntris * 3);
 
 	// The vertex array: 3D xyz, 3D normal, 2D st (8 floats per vertex)
 	glm::vec3 position, normal;
@@ -220,190 +264,107 @@ Mesh MeshCreator::createSphere(float radius, int segments) {
 		indices[base + 3 * i + 2] = nverts - 3 - i;
 	}
 
-	return Mesh(vertices, indices, ntris);
+	// Reorder for the vertex cache and vertex fetches
+	MeshOptimizer::optimizeMesh("sphere", vertices, indices);
 }
 
 /*
- * readObj(const char* filename)
+ * readObj(const char* filename, float weldEpsilon, Residency residency)
  *
  * Load geometry data from an OBJ file.
- * The vertex array is on interleaved format. For each vertex, there
- * are 8 floats: three for the vertex coordinates (x, y, z), three
- * for the normal vector (n_x, n_y, n_z) and finally two for texture
- * coordinates (s, t). The returned arrays are allocated by malloc()
- * inside the function and should be disposed of using free() when
- * they are no longer needed, e.g. by calling soupDelete().
+ * The file is memory mapped and parsed in parallel chunks by ObjParser.
+ * Corners with equal position, normal and texture coordinates share one
+ * vertex, and faces must be given as triangles with v/t/n indices.
+ * Positions within weldEpsilon of each other are snapped together first,
+ * which repairs the connectivity of meshes with small position jitter.
+ * The triangles and vertices are then reordered for the vertex cache and
+ * for vertex fetches.
  *
- * Author: Stefan Gustavson (stegu@itn.liu.se) 2014.
- * This code is in the public domain.
+ * The result, including adjacency and edge list indices, is cached in
+ * "<filename>.mesh". The cache is rebuilt when it is missing or when the
+ * OBJ file or weldEpsilon has changed, and otherwise mapped and uploaded
+ * directly. Only the CPU-side copies kept by the residency policy are made.
  *
+ * Based on code by Stefan Gustavson (stegu@itn.liu.se) 2014.
  * Modified by Emma Broman 2018 to fit with the Mesh class used in this project. 
  */
-Mesh MeshCreator::readOBJ(const char* filename) {
+Mesh MeshCreator::readOBJ(const char* filename, float weldEpsilon, Residency residency, VertexFormat format) {
 
-	FILE *objfile;
+	string cachePath = MeshCache::cachePath(filename);
+	MeshCache cache;
 
-	int numverts = 0;
-	int numnormals = 0;
-	int numtexcoords = 0;
-	int numfaces = 0;
-	int i_v = 0;
-	int i_n = 0;
-	int i_t = 0;
-	int i_f = 0;
-	float *verts, *normals, *texcoords;
+	if (!cache.open(cachePath.c_str(), filename, weldEpsilon)) {
+		vector<Vertex> vertices;
+		vector<GLuint> indices;
 
-	char line[256];
-	char tag[3];
-	int v1, v2, v3, n1, n2, n3, t1, t2, t3;
-	int numargs, readerror, currentv;
-
-	readerror = 0;
+		if (!ObjParser::parse(filename, vertices, indices, weldEpsilon)) {
+			return Mesh();
+		}
 
-	objfile = fopen(filename, "r");
+		MeshOptimizer::optimizeMesh(filename, vertices, indices);
 
-	if (!objfile) {
-		printError("File not found", filename);
-		readerror = 1;
+		// Use the parsed data directly if the cache can not be written
+		if (!MeshCache::write(cachePath.c_str(), filename, weldEpsilon, vertices, indices)
+			|| !cache.open(cachePath.c_str(), filename, weldEpsilon)) {
+			return createMesh(vertices, indices, residency, format);
+		}
 	}
 
-	// Scan through the file to count the number of data elements
-	while (fgets(line, 256, objfile)) {
-		sscanf(line, "%2s ", tag);
-		if (!strcmp(tag, "v")) numverts++;
-		else if (!strcmp(tag, "vn")) numnormals++;
-		else if (!strcmp(tag, "vt")) numtexcoords++;
-		else if (!strcmp(tag, "f")) numfaces++;
-		//else printf("Ignoring line starting with \"%s\"\n", tag);
-	}
+	return Mesh(cache.arrays(), residency, format);
+}
 
-	printf("loadObj(\"%s\"): found %d vertices, %d normals, %d texcoords, %d faces.\n",
-		filename, numverts, numnormals, numtexcoords, numfaces);
-
-	verts = new float[3 * numverts];
-	normals = new float[3 * numnormals];
-	texcoords = new float[2 * numtexcoords];
-
-	int nverts = 3 * numfaces;
-	int ntris = numfaces;
-
-	vector<Vertex> vertices(nverts);
-	vector<unsigned int> indices(ntris * 3);
-
-	rewind(objfile); // Start from the top again to read data
-
-	while (fgets(line, 256, objfile)) {
-		tag[0] = '\0';
-		sscanf(line, "%2s ", tag);
-		if (!strcmp(tag, "v")) {
-			//			printf("Reading vertex %d\n", i_v+1);
-			numargs = sscanf(line, "v %f %f %f",
-				&verts[3 * i_v], &verts[3 * i_v + 1], &verts[3 * i_v + 2]);
-			if (numargs != 3) {
-				printf("Malformed vertex data found at vertex %d.\n", i_v + 1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-			//			printf("Read vertex coord %d: %8.2f %8.2f %8.2f\n",
-			//			i_v, verts[3*i_v], verts[3*i_v+1], verts[3*i_v+2]);
-			i_v++;
-		}
-		else if (!strcmp(tag, "vn")) {
-			//			printf("Reading normal %d\n", i_n+1);
-			numargs = sscanf(line, "vn %f %f %f",
-				&normals[3 * i_n], &normals[3 * i_n + 1], &normals[3 * i_n + 2]);
-			if (numargs != 3) {
-				printf("Malformed normal data found at normal %d.\n", i_n + 1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-			i_n++;
-		}
-		else if (!strcmp(tag, "vt")) {
-			//          printf("Reading texcoord %d\n", i_t+1);
-			numargs = sscanf(line, "vt %f %f",
-				&texcoords[2 * i_t], &texcoords[2 * i_t + 1]);
-			if (numargs != 2) {
-				printf("Malformed texcoord data found at texcoord %d.\n", i_t + 1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-			i_t++;
-		}
-		else if (!strcmp(tag, "f")) {
-			//			printf("Reading face %d\n", i_f+1);
-			numargs = sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-				&v1, &t1, &n1, &v2, &t2, &n2, &v3, &t3, &n3);
-			if (numargs != 9) {
-				printf("Malformed face data found at face %d.\n", i_f + 1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-			//			printf("Read vertex data %d/%d/%d %d/%d/%d %d/%d/%d\n",
-			//			v1, t1, n1, v2, t2, n2, v3, t3, n3);
-			v1--; v2--; v3--; n1--; n2--; n3--; t1--; t2--; t3--;
-			currentv = 3 * i_f;
-
-			float x, y, z, nx, ny, nz, s, t;
-
-			x = verts[3 * v1];
-			y = verts[3 * v1 + 1];
-			z = verts[3 * v1 + 2];
-			nx = normals[3 * n1];
-			ny = normals[3 * n1 + 1];
-			nz = normals[3 * n1 + 2];
-			s = texcoords[2 * t1];
-			t = texcoords[2 * t1 + 1];
-
-			vertices[currentv] = Vertex{ glm::vec3(x, y, z), glm::vec3(nx, ny, nz), glm::vec2(s, t) };
-
-			x = verts[3 * v2];
-			y = verts[3 * v2 + 1];
-			z = verts[3 * v2 + 2];
-			nx = normals[3 * n2];
-			ny = normals[3 * n2 + 1];
-			nz = normals[3 * n2 + 2];
-			s = texcoords[2 * t2];
-			t = texcoords[2 * t2 + 1];
-
-			vertices[currentv+1] = Vertex{ glm::vec3(x, y, z), glm::vec3(nx, ny, nz), glm::vec2(s, t) };
-
-			x = verts[3 * v3];
-			y = verts[3 * v3 + 1];
-			z = verts[3 * v3 + 2];
-			nx = normals[3 * n3];
-			ny = normals[3 * n3 + 1];
-			nz = normals[3 * n3 + 2];
-			s = texcoords[2 * t3];
-			t = texcoords[2 * t3 + 1];
-
-			vertices[currentv+2] = Vertex{ glm::vec3(x, y, z), glm::vec3(nx, ny, nz), glm::vec2(s, t) };
-
-			// The index array:
-			indices[3 * i_f] = 3 * i_f;
-			indices[3 * i_f + 1] = 3 * i_f + 1;
-			indices[3 * i_f + 2] = 3 * i_f + 2;
-			i_f++;
-		};
+/*
+ * createShadowProxy(const Mesh& occluder, float maxError)
+ *
+ * Simplify the welded connectivity of an occluder with quadric error
+ * collapses. The quadric error bounds an average distance to the planes
+ * of the removed triangles, so parts of the result bulge out of the
+ * occluder. A proxy outside its occluder shadows the lit side of the
+ * occluder itself, so it is shrunk until it is inside, and its measured
+ * distance from the occluder is printed. Only positions are uploaded, and
+ * only the half-edge mesh is kept on the CPU, for shadow volumes
+ * generated on the CPU.
+ */
+Mesh MeshCreator::createShadowProxy(const Mesh& occluder, float maxError) {
+
+	const HalfEdgeMesh& connectivity = occluder.getHalfEdgeMesh();
+	if (connectivity.empty()) {
+		fprintf(stderr, "%s: %s\n", "Shadow proxy error", "occluder has no half-edge mesh");
+		return Mesh();
 	}
 
-	// Clean up the temporary arrays we created
-	delete[] verts; verts = NULL;
-	delete[] normals; normals = NULL;
-	delete[] texcoords; texcoords = NULL;
-	fclose(objfile);
+	vector<Vertex> vertices;
+	vector<GLuint> indices;
+	GLuint ntris = MeshSimplifier::simplify(connectivity, maxError, vertices, indices);
 
-	if (readerror) { // Delete corrupt data and bail out if a read error occured
-		printError("Mesh read error", "No mesh data generated");
+	SurfaceDistance occluderSurface(connectivity);
+	MeshSimplifier::shrinkInside(occluderSurface, vertices, indices);
+	printf("createShadowProxy: %u triangles, Hausdorff distance %g from the occluder\n", ntris,
+		SurfaceDistance::hausdorff(occluderSurface, SurfaceDistance(vertices, indices)));
+
+	MeshOptimizer::optimizeMesh("shadow proxy", vertices, indices);
+
+	Mesh proxy(std::move(vertices), std::move(indices), ntris, VertexFormat::PositionOnly);
+
+	proxy.useAdjacency();
+	proxy.useEdgeList();
+	proxy.setResidency(Residency::KeepConnectivity);
+	return proxy;
+}
+
+/*
+ * readMesh(const char* filename, Residency residency)
+ *
+ * Load a binary mesh file, as written by the OBJ cache. The file is
+ * mapped and uploaded directly.
+ */
+Mesh MeshCreator::readMesh(const char* filename, Residency residency, VertexFormat format) {
+
+	MeshCache cache;
+	if (!cache.open(filename)) {
+		fprintf(stderr, "%s: %s\n", "Mesh read error", filename);
 		return Mesh();
 	}
 
-	printf("loadObj(\"%s\"): found %d vertices, %d normals, %d texcoords, %d faces.\n",
-		filename, numverts, numnormals, numtexcoords, numfaces);
-
-	return Mesh(vertices, indices, ntris);
+	return Mesh(cache.arrays(), residency, format);
 }
@@ -16,6 +16,7 @@
 
 #include "Shader.h"
 #include "Mesh.h"
+#include "StagingArena.h"
 
 #include <string>
 #include <fstream>
@@ -27,16 +28,44 @@ using namespace std;
 class MeshCreator {
 
 public:
+	// Every factory uploads the vertices in the given format
+
 	// Create a simple triangle 
-	static Mesh createTriangle();
+	static Mesh createTriangle(VertexFormat format = VertexFormat::Float);
 
-	// Create a box with the dimension xsize * ysize * zsize 
-	static Mesh createBox(float xsize, float ysize, float zsize);
+	// Create a box with the dimension xsize * ysize * zsize. Meshes that do not keep all CPU-side data
+	// are generated in the staging arena and uploaded from there
+	static Mesh createBox(float xsize, float ysize, float zsize, Residency residency = Residency::KeepAll,
+		VertexFormat format = VertexFormat::Float);
 
 	// Create a sphere (approximated by polygon segments)
-	static Mesh createSphere(float radius, int segments);
+	static Mesh createSphere(float radius, int segments, Residency residency = Residency::KeepAll,
+		VertexFormat format = VertexFormat::Float);
+
+	// Generate the vertices and indices of the sphere into the given vectors, reordered for the vertex
+	// cache and for vertex fetches, without uploading them. The vectors are resized but keep their storage
+	static void generateSphere(float radius, int segments, vector<Vertex>& vertices, vector<GLuint>& indices);
+
+	// Load geometry from an OBJ file. Positions closer than weldEpsilon are welded together.
+	// The processed mesh is cached in a binary file next to the OBJ file, which is used instead while it is up to date
+	static Mesh readOBJ(const char* filename, float weldEpsilon = 0.0f, Residency residency = Residency::KeepAll,
+		VertexFormat format = VertexFormat::Float);
+
+	// Load a binary mesh file, as written by the OBJ cache
+	static Mesh readMesh(const char* filename, Residency residency = Residency::KeepAll,
+		VertexFormat format = VertexFormat::Float);
+
+	// Simplify an occluder into a closed, position-only proxy for the shadow volume passes, with adjacency,
+	// edge lists and its half-edge mesh. maxError is the quadric error bound of the simplification, in model
+	// units. The proxy is then shrunk to fit inside the occluder. The occluder must have its half-edge mesh
+	static Mesh createShadowProxy(const Mesh& occluder, float maxError);
+
+	// Storage reused by the generators for meshes that do not keep their CPU-side data
+	static StagingArena& staging();
 
-	// Load geometry from an OBJ file 
-	static Mesh readOBJ(const char* filename);
+private:
+	// Create a mesh from generated data. Meshes that keep all CPU-side data take over the vectors,
+	// the others are uploaded straight from them
+	static Mesh createMesh(vector<Vertex>& vertices, vector<GLuint>& indices, Residency residency, VertexFormat format);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,542 @@
+#include "MeshOptimizer.h"
+#include "Mesh.h"
+#include "Parallel.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// The bits of all vertex attributes. Adding 0.0f turns -0.0f into 0.0f, so equal values get equal bits
+static void vertexBits(const Vertex& v, uint32_t bits[8])
+{
+	const float values[8] = {
+		v.Position.x + 0.0f, v.Position.y + 0.0f, v.Position.z + 0.0f,
+		v.Normal.x + 0.0f, v.Normal.y + 0.0f, v.Normal.z + 0.0f,
+		v.TexCoords.x + 0.0f, v.TexCoords.y + 0.0f
+	};
+	std::memcpy(bits, values, 8 * sizeof(uint32_t));
+}
+
+static uint32_t hashVertex(const Vertex& v)
+{
+	uint32_t bits[8];
+	vertexBits(v, bits);
+
+	uint64_t h = 0;
+	for (uint32_t b : bits)
+	{
+		h = h * 0x9E3779B97F4A7C15ULL ^ b;
+	}
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	return uint32_t(h ^ (h >> 32));
+}
+
+static bool equalVertices(const Vertex& a, const Vertex& b)
+{
+	uint32_t bitsA[8], bitsB[8];
+	vertexBits(a, bitsA);
+	vertexBits(b, bitsB);
+	return std::memcmp(bitsA, bitsB, sizeof(bitsA)) == 0;
+}
+
+// Key of a grid cell. Every coordinate is wrapped to 21 bits, cells that end up with the same key
+// only cost some extra distance tests
+static uint64_t cellKey(int64_t x, int64_t y, int64_t z)
+{
+	const uint64_t mask = (1u << 21) - 1;
+	return (uint64_t(x) & mask) | ((uint64_t(y) & mask) << 21) | ((uint64_t(z) & mask) << 42);
+}
+
+// Size of the LRU cache modelled by the vertex cache optimization
+static const int FORSYTH_CACHE_SIZE = 32;
+
+// Forsyth's vertex score: vertices recently used score high (except the last triangle's, which are
+// used anyway), and vertices with few triangles left score high so that no lonely triangles are left behind
+static float forsythScore(int cachePosition, GLuint liveTriangles)
+{
+	if (liveTriangles == 0) return -1.0f; // No triangles left to use the vertex
+
+	float score = 0.0f;
+	if (cachePosition >= 0 && cachePosition < 3) {
+		score = 0.75f;
+	}
+	else if (cachePosition >= 3 && cachePosition < FORSYTH_CACHE_SIZE) {
+		float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+		score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+	}
+
+	return score + 2.0f / std::sqrt(float(liveTriangles));
+}
+
+// Largest weld cell coordinate, a float that converts exactly and leaves room for the neighbour offsets
+static const float MAX_CELL = 4611686018427387904.0f; // 2^62
+
+// Mix the bits of a cell key, used to spread the cells over the hash table
+static uint64_t mixCellKey(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xFF51AFD7ED558CCDULL;
+	k ^= k >> 33;
+	return k;
+}
+
+// ***************************************************************************
+// * PUBLIC
+// ***************************************************************************
+
+// Vertices are visited in order, and each one either snaps to the first earlier representative within
+// epsilon or becomes a representative itself. Only representatives are stored in the grid. With cells of
+// size epsilon, all candidates are in the 3x3x3 cells around the vertex, so the weld runs in linear time.
+GLuint MeshOptimizer::weldPositions(std::vector<Vertex>& vertices, float epsilon)
+{
+	if (!(epsilon > 0.0f)) return 0; // Exact matches are already welded by indexVertices
+
+	const GLuint nverts = GLuint(vertices.size());
+	const float epsilon2 = epsilon * epsilon;
+	const float cellScale = 1.0f / epsilon;
+
+	// Open addressing table of the cells holding representatives, with the key and the latest
+	// representative of each cell. The other representatives in a cell are linked by nextInCell
+	size_t capacity = 16;
+	while (capacity < 2 * size_t(nverts)) capacity *= 2;
+	const size_t mask = capacity - 1;
+	std::vector<uint64_t> cellKeys(capacity);
+	std::vector<GLuint> cellHeads(capacity, HalfEdgeMesh::INVALID);
+	std::vector<GLuint> nextInCell(nverts, HalfEdgeMesh::INVALID);
+
+	auto findCell = [&](uint64_t key) {
+		size_t slot = mixCellKey(key) & mask;
+		while (cellHeads[slot] != HalfEdgeMesh::INVALID && cellKeys[slot] != key)
+		{
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	};
+
+	GLuint moved = 0;
+	for (GLuint i = 0; i < nverts; i++)
+	{
+		glm::vec3 &p = vertices[i].Position;
+		glm::vec3 cell = glm::floor(p * cellScale);
+		if (!std::isfinite(cell.x) || !std::isfinite(cell.y) || !std::isfinite(cell.z)) continue;
+
+		// Far out cells are clamped so the conversion and the neighbour offsets stay in range. Clamped
+		// vertices share cells with distant ones, which the distance test still tells apart
+		cell = glm::clamp(cell, -MAX_CELL, MAX_CELL);
+
+		const int64_t cx = int64_t(cell.x), cy = int64_t(cell.y), cz = int64_t(cell.z);
+
+		// Find the earliest representative within epsilon
+		GLuint found = HalfEdgeMesh::INVALID;
+		for (int64_t dz = -1; dz <= 1; dz++)
+		{
+			for (int64_t dy = -1; dy <= 1; dy++)
+			{
+				for (int64_t dx = -1; dx <= 1; dx++)
+				{
+					size_t slot = findCell(cellKey(cx + dx, cy + dy, cz + dz));
+
+					for (GLuint r = cellHeads[slot]; r != HalfEdgeMesh::INVALID; r = nextInCell[r])
+					{
+						glm::vec3 d = vertices[r].Position - p;
+						if (r < found && glm::dot(d, d) <= epsilon2) found = r;
+					}
+				}
+			}
+		}
+
+		if (found != HalfEdgeMesh::INVALID) {
+			if (vertices[found].Position != p) moved++;
+			p = vertices[found].Position;
+			continue;
+		}
+
+		// New representative, linked in front of the others in its cell
+		uint64_t key = cellKey(cx, cy, cz);
+		size_t slot = findCell(key);
+		cellKeys[slot] = key;
+		nextInCell[i] = cellHeads[slot];
+		cellHeads[slot] = i;
+	}
+
+	return moved;
+}
+
+GLuint MeshOptimizer::indexVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, unsigned threads)
+{
+	const size_t nverts = vertices.size();
+
+	std::vector<GLuint> remap, firsts;
+	GLuint nunique = findUnique(nverts,
+		[&](size_t i) { return hashVertex(vertices[i]); },
+		[&](size_t i, size_t j) { return equalVertices(vertices[i], vertices[j]); },
+		remap, firsts, threads);
+	if (nunique == nverts) return nunique; // Nothing to merge
+
+	std::vector<Vertex> unique(nunique);
+	Parallel::forChunks(nunique, Parallel::numThreads(threads), [&](size_t begin, size_t end, unsigned) {
+		for (size_t v = begin; v < end; v++)
+		{
+			unique[v] = vertices[firsts[v]];
+		}
+	});
+
+	Parallel::forChunks(indices.size(), Parallel::numThreads(threads), [&](size_t begin, size_t end, unsigned) {
+		for (size_t i = begin; i < end; i++)
+		{
+			indices[i] = remap[indices[i]];
+		}
+	});
+
+	vertices.swap(unique);
+	return nunique;
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<GLuint>& indices, GLuint nverts, GLuint cacheSize)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || nverts == 0) return stats;
+
+	// The time each vertex entered the cache. A vertex is in the cache while fewer than cacheSize
+	// vertices have entered after it
+	std::vector<GLuint> entered(nverts, 0);
+	GLuint time = cacheSize + 1;
+
+	for (GLuint v : indices)
+	{
+		if (time - entered[v] > cacheSize) {
+			entered[v] = time++;
+			stats.misses++;
+		}
+	}
+
+	stats.acmr = float(stats.misses) / float(indices.size() / 3);
+	stats.atvr = float(stats.misses) / float(nverts);
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<GLuint>& indices, GLuint nverts, std::vector<GLuint>* triangleOrder)
+{
+	const GLuint ntris = GLuint(indices.size() / 3);
+	if (triangleOrder) triangleOrder->clear();
+	if (ntris == 0) return;
+
+	// The triangles of each vertex. The first liveTriangles[v] entries are the triangles not yet emitted
+	std::vector<GLuint> liveTriangles(nverts, 0), offsets(nverts + 1, 0);
+	for (GLuint v : indices) liveTriangles[v]++;
+	for (GLuint v = 0; v < nverts; v++) offsets[v + 1] = offsets[v] + liveTriangles[v];
+
+	std::vector<GLuint> vertexTriangles(indices.size()), filled(nverts, 0);
+	for (GLuint t = 0; t < ntris; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = indices[3 * t + k];
+			vertexTriangles[offsets[v] + filled[v]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(nverts, -1);
+	std::vector<float> vertexScore(nverts);
+	for (GLuint v = 0; v < nverts; v++)
+	{
+		vertexScore[v] = forsythScore(-1, liveTriangles[v]);
+	}
+
+	std::vector<float> triangleScore(ntris);
+	std::vector<bool> emitted(ntris, false);
+	GLuint best = 0;
+	for (GLuint t = 0; t < ntris; t++)
+	{
+		triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+		if (triangleScore[t] > triangleScore[best]) best = t;
+	}
+
+	std::vector<GLuint> cache, newCache, result;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	result.reserve(indices.size());
+	GLuint nextUnemitted = 0;
+
+	for (GLuint n = 0; n < ntris; n++)
+	{
+		// No triangle touches the cache, continue with the next one in input order
+		if (best == HalfEdgeMesh::INVALID) {
+			while (emitted[nextUnemitted]) nextUnemitted++;
+			best = nextUnemitted;
+		}
+
+		const GLuint *tri = &indices[3 * best];
+		result.insert(result.end(), tri, tri + 3);
+		emitted[best] = true;
+		if (triangleOrder) triangleOrder->push_back(best);
+
+		// Remove the triangle from the live triangles of its vertices
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = tri[k];
+			GLuint *triangles = &vertexTriangles[offsets[v]];
+			GLuint *last = triangles + liveTriangles[v] - 1;
+			std::swap(*std::find(triangles, last, best), *last);
+			liveTriangles[v]--;
+		}
+
+		// The triangle's vertices move to the front of the cache
+		newCache.assign(tri, tri + 3);
+		for (GLuint v : cache)
+		{
+			if (v != tri[0] && v != tri[1] && v != tri[2]) newCache.push_back(v);
+		}
+
+		// Update the vertices in the cache, including those just pushed out of it
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			GLuint v = newCache[i];
+			cachePosition[v] = (i < FORSYTH_CACHE_SIZE) ? int(i) : -1;
+			vertexScore[v] = forsythScore(cachePosition[v], liveTriangles[v]);
+		}
+
+		// The best triangle is one of the live triangles of these vertices
+		best = HalfEdgeMesh::INVALID;
+		float bestScore = -1.0f;
+		for (GLuint v : newCache)
+		{
+			for (GLuint i = 0; i < liveTriangles[v]; i++)
+			{
+				GLuint t = vertexTriangles[offsets[v] + i];
+				const GLuint *corners = &indices[3 * t];
+				triangleScore[t] = vertexScore[corners[0]] + vertexScore[corners[1]] + vertexScore[corners[2]];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+
+		if (newCache.size() > FORSYTH_CACHE_SIZE) newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin()); // Keeps the caller's storage
+}
+
+// Number of cache misses of the triangles [begin, end), starting from an empty FIFO cache.
+// entered and time keep the cache state between calls, see analyzeVertexCache
+static GLuint countCacheMisses(const std::vector<GLuint>& indices, GLuint begin, GLuint end, GLuint cacheSize,
+	std::vector<GLuint>& entered, GLuint& time)
+{
+	time += cacheSize + 1; // Empty the cache
+	GLuint misses = 0;
+	for (GLuint i = 3 * begin; i < 3 * end; i++)
+	{
+		GLuint v = indices[i];
+		if (time - entered[v] > cacheSize) {
+			entered[v] = time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+// Based on the cluster sorting of Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+// Hard cluster boundaries are where all three vertices miss the cache. Those clusters are split further where the
+// ACMR of the cluster so far, starting from an empty cache, is within threshold of the ACMR of the hard cluster,
+// so drawing the clusters in any order costs at most that much cache efficiency.
+GLuint MeshOptimizer::optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices,
+	std::vector<GLuint>* triangleOrder, GLuint cacheSize, float threshold)
+{
+	const GLuint ntris = GLuint(indices.size() / 3);
+	if (triangleOrder) triangleOrder->clear();
+	if (ntris == 0) return 0;
+
+	std::vector<GLuint> entered(vertices.size(), 0);
+	GLuint time = 0;
+
+	// Hard boundaries: the FIFO cache misses all three vertices
+	std::vector<GLuint> hardStart;
+	time += cacheSize + 1;
+	for (GLuint t = 0; t < ntris; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = indices[3 * t + k];
+			if (time - entered[v] > cacheSize) {
+				entered[v] = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 || t == 0) hardStart.push_back(t);
+	}
+	hardStart.push_back(ntris);
+
+	// Soft boundaries inside the hard clusters
+	std::vector<GLuint> clusterStart;
+	for (size_t h = 0; h + 1 < hardStart.size(); h++)
+	{
+		const GLuint begin = hardStart[h], end = hardStart[h + 1];
+		float clusterACMR = float(countCacheMisses(indices, begin, end, cacheSize, entered, time)) / float(end - begin);
+
+		GLuint start = begin;
+		GLuint misses = 0;
+		time += cacheSize + 1;
+		for (GLuint t = begin; t < end; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint v = indices[3 * t + k];
+				if (time - entered[v] > cacheSize) {
+					entered[v] = time++;
+					misses++;
+				}
+			}
+
+			if (float(misses) <= threshold * clusterACMR * float(t + 1 - start) || t + 1 == end) {
+				clusterStart.push_back(start);
+				start = t + 1;
+				misses = 0;
+				time += cacheSize + 1;
+			}
+		}
+	}
+
+	const GLuint nclusters = GLuint(clusterStart.size());
+	clusterStart.push_back(ntris);
+
+	// Area weighted centroid and normal of every cluster and of the whole mesh
+	std::vector<glm::vec3> clusterCentroid(nclusters), clusterNormal(nclusters);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (GLuint c = 0; c < nclusters; c++)
+	{
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+
+		for (GLuint t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+		{
+			const glm::vec3 &p0 = vertices[indices[3 * t]].Position;
+			const glm::vec3 &p1 = vertices[indices[3 * t + 1]].Position;
+			const glm::vec3 &p2 = vertices[indices[3 * t + 2]].Position;
+
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float a = glm::length(n);
+
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+		clusterCentroid[c] = (area > 0.0f) ? centroid / area : centroid;
+		clusterNormal[c] = normal;
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	// Clusters facing away from the center are likely to be in front of the others
+	std::vector<float> sortKey(nclusters, 0.0f);
+	for (GLuint c = 0; c < nclusters; c++)
+	{
+		float length = glm::length(clusterNormal[c]);
+		if (length > 0.0f) sortKey[c] = glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c] / length);
+	}
+
+	std::vector<GLuint> order(nclusters);
+	for (GLuint c = 0; c < nclusters; c++) order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](GLuint a, GLuint b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for (GLuint c : order)
+	{
+		result.insert(result.end(), indices.begin() + 3 * clusterStart[c], indices.begin() + 3 * clusterStart[c + 1]);
+		for (GLuint t = clusterStart[c]; triangleOrder && t < clusterStart[c + 1]; t++) triangleOrder->push_back(t);
+	}
+	indices.swap(result);
+
+	return nclusters;
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<GLuint>& vertexRemap)
+{
+	const GLuint nverts = GLuint(vertices.size());
+	vertexRemap.assign(nverts, HalfEdgeMesh::INVALID);
+
+	// Number the vertices in order of first use
+	GLuint next = 0;
+	for (GLuint &i : indices)
+	{
+		if (vertexRemap[i] == HalfEdgeMesh::INVALID) vertexRemap[i] = next++;
+		i = vertexRemap[i];
+	}
+
+	// Vertices not used by any triangle go last
+	for (GLuint v = 0; v < nverts; v++)
+	{
+		if (vertexRemap[v] == HalfEdgeMesh::INVALID) vertexRemap[v] = next++;
+	}
+
+	// Apply the permutation in place, one cycle at a time, so the caller's storage is kept
+	std::vector<bool> placed(nverts, false);
+	for (GLuint start = 0; start < nverts; start++)
+	{
+		if (placed[start]) continue;
+
+		Vertex moving = vertices[start];
+		GLuint v = start;
+		do {
+			GLuint target = vertexRemap[v];
+			std::swap(moving, vertices[target]);
+			placed[v] = true;
+			v = target;
+		} while (v != start);
+	}
+}
+
+void MeshOptimizer::reorderTriangles(std::vector<GLuint>& stream, GLuint indicesPerTriangle, const std::vector<GLuint>& triangleOrder)
+{
+	std::vector<GLuint> result(stream.size());
+	for (size_t t = 0; t < triangleOrder.size(); t++)
+	{
+		std::copy_n(&stream[indicesPerTriangle * triangleOrder[t]], indicesPerTriangle, &result[indicesPerTriangle * t]);
+	}
+	stream.swap(result);
+}
+
+void MeshOptimizer::remapIndices(std::vector<GLuint>& stream, const std::vector<GLuint>& vertexRemap)
+{
+	for (GLuint &i : stream)
+	{
+		i = vertexRemap[i];
+	}
+}
+
+void MeshOptimizer::optimizeMesh(const char* name, std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+	std::vector<GLuint>* adjacency, GLuint cacheSize)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	const GLuint nverts = GLuint(vertices.size());
+
+	VertexCacheStats before = analyzeVertexCache(indices, nverts, cacheSize);
+
+	std::vector<GLuint> triangleOrder, vertexRemap;
+	optimizeVertexCache(indices, nverts, adjacency ? &triangleOrder : nullptr);
+	optimizeVertexFetch(vertices, indices, vertexRemap);
+
+	if (adjacency && !adjacency->empty()) {
+		reorderTriangles(*adjacency, 6, triangleOrder);
+		remapIndices(*adjacency, vertexRemap);
+	}
+
+	VertexCacheStats after = analyzeVertexCache(indices, nverts, cacheSize);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> optimizeTime = endTime - startTime;
+	printf("optimizeMesh(\"%s\"): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (FIFO %u) in %.2f ms\n",
+		name, before.acmr, after.acmr, before.atvr, after.atvr, cacheSize, optimizeTime.count());
+}
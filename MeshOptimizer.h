@@ -0,0 +1,160 @@
+/*
+ *	Processing steps that turn loaded geometry into a compact indexed mesh before it is uploaded.
+ *	All steps work on a vertex buffer and a triangle index list, and are split over threads
+ *	without making the result depend on the thread count.
+ */
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "Parallel.h"
+
+#include <vector>
+#include <cstdint>
+
+struct Vertex;
+
+class MeshOptimizer {
+public:
+	// Snap vertex positions that lie within epsilon of an earlier vertex to the position of that vertex,
+	// so nearly coincident corners are welded by indexVertices and by the half-edge mesh.
+	// Uses a uniform hash grid with cells of size epsilon. Returns the number of moved vertices
+	static GLuint weldPositions(std::vector<Vertex>& vertices, float epsilon);
+
+	// Merge vertices with equal position, normal and texture coordinates and remap the indices to them.
+	// The unique vertices keep the order of their first occurrence. Returns the number of unique vertices
+	static GLuint indexVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, unsigned threads = 0);
+
+	// Results of simulating a FIFO post-transform vertex cache on an index buffer
+	struct VertexCacheStats {
+		GLuint misses = 0;	// Vertices transformed
+		float acmr = 0.0f;	// Average cache miss ratio: transformed vertices per triangle (0.5 - 3)
+		float atvr = 0.0f;	// Average transformed vertex ratio: transformed vertices per vertex (1 is optimal)
+	};
+
+	// Simulate a FIFO post-transform vertex cache with cacheSize entries
+	static VertexCacheStats analyzeVertexCache(const std::vector<GLuint>& indices, GLuint nverts, GLuint cacheSize = 16);
+
+	// Reorder the triangles so consecutive triangles share vertices, using Forsyth's linear-speed
+	// vertex cache optimization with an LRU cache model. triangleOrder (if given) receives the old
+	// triangle at every new position, for reordering other per-triangle streams
+	static void optimizeVertexCache(std::vector<GLuint>& indices, GLuint nverts, std::vector<GLuint>* triangleOrder = nullptr);
+
+	// Reorder clusters of the (vertex cache optimized) triangles so that the clusters facing away from the
+	// mesh center are drawn first and occlude the rest. Clusters are cut where the ACMR with a FIFO cache of
+	// cacheSize entries grows by at most threshold (1.05 = 5%). Returns the number of clusters
+	static GLuint optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices,
+		std::vector<GLuint>* triangleOrder = nullptr, GLuint cacheSize = 16, float threshold = 1.05f);
+
+	// Reorder the vertices in order of first use by the triangles, so vertex fetches are close in memory.
+	// The vertices are permuted in place. vertexRemap receives the new index of every old vertex, for
+	// remapping other index streams
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<GLuint>& vertexRemap);
+
+	// Reorder a stream with indicesPerTriangle entries per triangle (e.g. 6 for adjacency) by a triangle order
+	static void reorderTriangles(std::vector<GLuint>& stream, GLuint indicesPerTriangle, const std::vector<GLuint>& triangleOrder);
+
+	// Replace every vertex index in a stream by its new index
+	static void remapIndices(std::vector<GLuint>& stream, const std::vector<GLuint>& vertexRemap);
+
+	// Reorder the triangles for the vertex cache and then the vertices for fetch locality, and print the
+	// ACMR and ATVR before and after. Adjacency indices (6 per triangle), if given, are reordered along with them
+	static void optimizeMesh(const char* name, std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+		std::vector<GLuint>* adjacency = nullptr, GLuint cacheSize = 16);
+
+	// Number the distinct elements of [0, count) in order of first occurrence, comparing them by index with
+	// hash(i) and equal(i, j). Fills remap with the number of every element and firsts with the first
+	// element of every number. Returns the number of distinct elements
+	template <typename Hash, typename Equal>
+	static GLuint findUnique(size_t count, Hash hash, Equal equal, std::vector<GLuint>& remap,
+		std::vector<GLuint>& firsts, unsigned threads = 0);
+};
+
+// Elements are split over one hash table per thread by their hash, so every table sees its elements
+// in the same order as a serial scan. Distinct elements are then numbered in order of first occurrence
+// with a prefix sum, which makes the result independent of the thread count.
+template <typename Hash, typename Equal>
+GLuint MeshOptimizer::findUnique(size_t count, Hash hash, Equal equal, std::vector<GLuint>& remap,
+	std::vector<GLuint>& firsts, unsigned threads)
+{
+	const GLuint empty = 0xFFFFFFFF;
+	threads = Parallel::numThreads(threads);
+
+	// Hash every element once
+	std::vector<uint32_t> hashes(count);
+	Parallel::forChunks(count, threads, [&](size_t begin, size_t end, unsigned) {
+		for (size_t i = begin; i < end; i++)
+		{
+			hashes[i] = uint32_t(hash(i));
+		}
+	});
+
+	// Find the first element equal to each element (stored in remap for now). The elements of a
+	// thread are kept in an open addressing table of element indices, so nothing is allocated per element
+	remap.resize(count);
+	Parallel::forEachThread(threads, [&](unsigned t) {
+		size_t owned = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (hashes[i] % threads == t) owned++;
+		}
+
+		size_t capacity = 16;
+		while (capacity < 2 * owned) capacity *= 2;
+		const size_t mask = capacity - 1;
+		std::vector<GLuint> table(capacity, empty);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			if (hashes[i] % threads != t) continue;
+
+			size_t slot = (hashes[i] / threads) & mask;
+			while (table[slot] != empty && !equal(size_t(table[slot]), i))
+			{
+				slot = (slot + 1) & mask;
+			}
+			if (table[slot] == empty) table[slot] = GLuint(i);
+			remap[i] = table[slot];
+		}
+	});
+
+	// Count the first occurrences in each chunk and turn the counts into chunk offsets
+	std::vector<GLuint> chunkOffset(threads + 1, 0);
+	Parallel::forChunks(count, threads, [&](size_t begin, size_t end, unsigned c) {
+		GLuint n = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			if (remap[i] == i) n++;
+		}
+		chunkOffset[c + 1] = n;
+	});
+	for (unsigned c = 0; c < threads; c++)
+	{
+		chunkOffset[c + 1] += chunkOffset[c];
+	}
+
+	// Number the first occurrences. Their numbers are stored in hashes until every element is remapped
+	const GLuint nunique = chunkOffset[threads];
+	firsts.resize(nunique);
+	Parallel::forChunks(count, threads, [&](size_t begin, size_t end, unsigned c) {
+		GLuint v = chunkOffset[c];
+		for (size_t i = begin; i < end; i++)
+		{
+			if (remap[i] != i) continue;
+			firsts[v] = GLuint(i);
+			hashes[i] = v++;
+		}
+	});
+
+	Parallel::forChunks(count, threads, [&](size_t begin, size_t end, unsigned) {
+		for (size_t i = begin; i < end; i++)
+		{
+			remap[i] = hashes[remap[i]];
+		}
+	});
+
+	return nunique;
+}
+#endif
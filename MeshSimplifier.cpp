@@ -0,0 +1,449 @@
+#include "MeshSimplifier.h"
+#include "HalfEdgeMesh.h"
+#include "Mesh.h"
+#include "SurfaceDistance.h"
+
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <queue>
+
+// Passes of shrinkInside before it gives up on the points still outside, and the distance outside, relative
+// to the size of the surface, that is within float precision of the surface
+static const int MAX_INSET_PASSES = 8;
+static const float INSET_TOLERANCE = 1e-5f;
+
+// Symmetric 4x4 quadric: the sum of the squared distances to a set of planes, weighted by triangle area.
+// The weight is accumulated with it so the error can be turned into a mean squared distance
+struct Quadric {
+	double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+	double weight = 0;
+
+	// Quadric of the plane n.p + d = 0, with a unit normal n
+	static Quadric plane(const glm::dvec3& n, double d, double weight)
+	{
+		Quadric q;
+		q.a2 = weight * n.x * n.x; q.ab = weight * n.x * n.y; q.ac = weight * n.x * n.z; q.ad = weight * n.x * d;
+		q.b2 = weight * n.y * n.y; q.bc = weight * n.y * n.z; q.bd = weight * n.y * d;
+		q.c2 = weight * n.z * n.z; q.cd = weight * n.z * d;
+		q.d2 = weight * d * d;
+		q.weight = weight;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd; d2 += q.d2; weight += q.weight;
+		return *this;
+	}
+
+	// Weighted sum of the squared distances from p to the planes
+	double error(const glm::dvec3& p) const
+	{
+		return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+			+ b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+			+ c2 * p.z * p.z + 2 * cd * p.z + d2;
+	}
+
+	// Point with the smallest error, if the planes constrain all three axes
+	bool optimum(glm::dvec3& p) const
+	{
+		glm::dmat3 A(a2, ab, ac, ab, b2, bc, ac, bc, c2);
+		double det = glm::determinant(A);
+		double trace = a2 + b2 + c2;
+		if (std::abs(det) <= 1e-12 * trace * trace * trace) return false;
+
+		p = glm::inverse(A) * glm::dvec3(-ad, -bd, -cd);
+		return true;
+	}
+};
+
+// A candidate edge collapse. Vertex b is merged into vertex a at the given position.
+// The stamps tell if either vertex has changed since the collapse was evaluated
+struct Collapse {
+	double cost;
+	GLuint a, b;
+	GLuint stampA, stampB;
+	glm::vec3 position;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+// Working copy of the mesh with per-vertex triangle lists, which the collapses edit in place
+class Simplifier {
+public:
+	Simplifier(const HalfEdgeMesh& mesh);
+
+	void run(double maxSquaredError);
+	GLuint output(std::vector<Vertex>& vertices, std::vector<GLuint>& indices) const;
+
+	GLuint numCollapses() const { return collapses; }
+
+private:
+	std::vector<glm::vec3> positions;
+	std::vector<Quadric> quadrics;
+	std::vector<GLuint> stamps;				// Incremented every time a vertex moves
+	std::vector<bool> vertexAlive;
+	std::vector<GLuint> triangles;			// 3 vertices per triangle
+	std::vector<bool> triangleAlive;
+	std::vector<std::vector<GLuint>> vertexTriangles;
+	GLuint liveTriangles = 0;
+	GLuint collapses = 0;
+
+	// Scratch marks for neighbor tests, valid when equal to markStamp
+	std::vector<GLuint> marks;
+	GLuint markStamp = 0;
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+	void pushCollapse(GLuint a, GLuint b);
+	bool isValid(const Collapse& c);
+	void apply(const Collapse& c);
+	bool hasVertex(GLuint t, GLuint v) const
+	{
+		return triangles[3 * t] == v || triangles[3 * t + 1] == v || triangles[3 * t + 2] == v;
+	}
+};
+
+Simplifier::Simplifier(const HalfEdgeMesh& mesh)
+{
+	const GLuint nverts = mesh.numVertices();
+	const GLuint nfaces = mesh.numFaces();
+
+	positions.resize(nverts);
+	for (GLuint v = 0; v < nverts; v++)
+	{
+		positions[v] = mesh.position(v);
+	}
+	quadrics.resize(nverts);
+	stamps.assign(nverts, 0);
+	vertexAlive.assign(nverts, true);
+	marks.assign(nverts, 0);
+	vertexTriangles.resize(nverts);
+
+	triangles.resize(3 * size_t(nfaces));
+	triangleAlive.assign(nfaces, true);
+	for (GLuint f = 0; f < nfaces; f++)
+	{
+		GLuint h = HalfEdgeMesh::faceHalfEdge(f);
+		for (GLuint k = 0; k < 3; k++)
+		{
+			GLuint v = mesh.origin(h + k);
+			triangles[3 * f + k] = v;
+			vertexTriangles[v].push_back(f);
+		}
+
+		// Plane quadric weighted by area, added to the three corners
+		glm::dvec3 p0 = positions[triangles[3 * f]], p1 = positions[triangles[3 * f + 1]], p2 = positions[triangles[3 * f + 2]];
+		glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(n);
+		if (length > 0.0) {
+			n /= length;
+			Quadric q = Quadric::plane(n, -glm::dot(n, p0), 0.5 * length);
+			for (GLuint k = 0; k < 3; k++)
+			{
+				quadrics[triangles[3 * f + k]] += q;
+			}
+		}
+
+		// Boundary edges are held in place by a plane perpendicular to the face through the edge
+		for (GLuint k = 0; k < 3; k++)
+		{
+			if (!mesh.isBoundary(h + k) || length == 0.0) continue;
+
+			glm::dvec3 e0 = positions[mesh.origin(h + k)], e1 = positions[mesh.target(h + k)];
+			glm::dvec3 edge = e1 - e0;
+			glm::dvec3 side = glm::cross(edge, n);
+			double sideLength = glm::length(side);
+			if (sideLength == 0.0) continue;
+			side /= sideLength;
+
+			Quadric q = Quadric::plane(side, -glm::dot(side, e0), glm::dot(edge, edge));
+			q.weight = 0.0; // A constraint, not part of the surface
+			quadrics[mesh.origin(h + k)] += q;
+			quadrics[mesh.target(h + k)] += q;
+		}
+	}
+	liveTriangles = nfaces;
+
+	// One candidate per unique edge
+	for (GLuint h = 0; h < mesh.numHalfEdges(); h++)
+	{
+		GLuint twin = mesh.twin(h);
+		if (twin == HalfEdgeMesh::INVALID || h < twin) pushCollapse(mesh.origin(h), mesh.target(h));
+	}
+}
+
+// Evaluate the cost of merging a and b and add it to the heap
+// The position is the quadric optimum, or else the best of the end points and the midpoint
+void Simplifier::pushCollapse(GLuint a, GLuint b)
+{
+	if (a == b) return;
+
+	Quadric q = quadrics[a];
+	q += quadrics[b];
+
+	glm::dvec3 pa = positions[a], pb = positions[b];
+	glm::dvec3 best;
+	double bestError;
+	// Nearly flat neighborhoods have optima far along the flat directions, those are not used
+	if (q.optimum(best) && glm::distance(best, 0.5 * (pa + pb)) <= glm::distance(pa, pb)) {
+		bestError = q.error(best);
+	} else {
+		best = pa;
+		bestError = q.error(pa);
+		const glm::dvec3 candidates[2] = { pb, 0.5 * (pa + pb) };
+		for (const glm::dvec3& p : candidates)
+		{
+			double error = q.error(p);
+			if (error < bestError) {
+				best = p;
+				bestError = error;
+			}
+		}
+	}
+
+	Collapse c;
+	c.cost = std::max(bestError, 0.0) / std::max(q.weight, 1e-30);
+	c.a = a;
+	c.b = b;
+	c.stampA = stamps[a];
+	c.stampB = stamps[b];
+	c.position = glm::vec3(best);
+	heap.push(c);
+}
+
+// Check that a collapse is up to date, keeps the mesh manifold and flips no triangle
+bool Simplifier::isValid(const Collapse& c)
+{
+	if (!vertexAlive[c.a] || !vertexAlive[c.b]) return false;
+	if (stamps[c.a] != c.stampA || stamps[c.b] != c.stampB) return false;
+
+	// Triangles on the edge, and the vertices opposite to it
+	GLuint shared = 0;
+	for (GLuint t : vertexTriangles[c.a])
+	{
+		if (hasVertex(t, c.b)) shared++;
+	}
+	if (shared == 0) return false; // The edge no longer exists
+	if (liveTriangles - shared < 4) return false; // Keep at least a tetrahedron
+
+	// Link condition: the only vertices adjacent to both a and b are the ones opposite to the edge
+	markStamp++;
+	for (GLuint t : vertexTriangles[c.a])
+	{
+		for (GLuint k = 0; k < 3; k++) marks[triangles[3 * t + k]] = markStamp;
+	}
+	GLuint common = 0;
+	markStamp++;
+	for (GLuint t : vertexTriangles[c.b])
+	{
+		for (GLuint k = 0; k < 3; k++)
+		{
+			GLuint v = triangles[3 * t + k];
+			if (v == c.a || v == c.b) continue;
+			if (marks[v] == markStamp - 1) {
+				common++;
+				marks[v] = markStamp; // Count each vertex once
+			}
+		}
+	}
+	if (common != shared) return false;
+
+	// No triangle that stays may turn over
+	const GLuint ends[2] = { c.a, c.b };
+	for (GLuint v : ends)
+	{
+		for (GLuint t : vertexTriangles[v])
+		{
+			if (hasVertex(t, c.a) && hasVertex(t, c.b)) continue; // Removed by the collapse
+
+			glm::vec3 p[3], moved[3];
+			for (GLuint k = 0; k < 3; k++)
+			{
+				GLuint u = triangles[3 * t + k];
+				p[k] = positions[u];
+				moved[k] = (u == v) ? c.position : p[k];
+			}
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			float lengths = glm::length(before) * glm::length(after);
+			if (glm::length(before) == 0.0f) continue; // Degenerate already, nothing to flip
+			if (lengths == 0.0f || glm::dot(before, after) < 0.2f * lengths) return false;
+		}
+	}
+	return true;
+}
+
+// Merge b into a: the triangles on the edge are removed and the rest of b's triangles move to a
+void Simplifier::apply(const Collapse& c)
+{
+	positions[c.a] = c.position;
+	quadrics[c.a] += quadrics[c.b];
+	vertexAlive[c.b] = false;
+	stamps[c.a]++;
+	stamps[c.b]++;
+
+	for (GLuint t : vertexTriangles[c.b])
+	{
+		if (hasVertex(t, c.a)) {
+			triangleAlive[t] = false;
+			liveTriangles--;
+			continue;
+		}
+		for (GLuint k = 0; k < 3; k++)
+		{
+			if (triangles[3 * t + k] == c.b) triangles[3 * t + k] = c.a;
+		}
+		vertexTriangles[c.a].push_back(t);
+	}
+	std::vector<GLuint>().swap(vertexTriangles[c.b]);
+
+	// Drop the removed triangles from the lists of the vertices around the edge
+	std::vector<GLuint>& around = vertexTriangles[c.a];
+	markStamp++;
+	for (GLuint t : around)
+	{
+		for (GLuint k = 0; k < 3; k++)
+		{
+			GLuint v = triangles[3 * t + k];
+			if (marks[v] == markStamp || v == c.a) continue;
+			marks[v] = markStamp;
+
+			std::vector<GLuint>& list = vertexTriangles[v];
+			list.erase(std::remove_if(list.begin(), list.end(), [&](GLuint u) { return !triangleAlive[u]; }), list.end());
+		}
+	}
+	around.erase(std::remove_if(around.begin(), around.end(), [&](GLuint u) { return !triangleAlive[u]; }), around.end());
+
+	// The edges around a have new costs
+	markStamp++;
+	for (GLuint t : around)
+	{
+		for (GLuint k = 0; k < 3; k++)
+		{
+			GLuint v = triangles[3 * t + k];
+			if (v == c.a || marks[v] == markStamp) continue;
+			marks[v] = markStamp;
+			pushCollapse(c.a, v);
+		}
+	}
+
+	collapses++;
+}
+
+// Collapse edges until the cheapest one is above the error bound
+void Simplifier::run(double maxSquaredError)
+{
+	while (!heap.empty())
+	{
+		Collapse c = heap.top();
+		if (c.cost > maxSquaredError) break;
+		heap.pop();
+
+		if (isValid(c)) apply(c);
+	}
+}
+
+// Compact the remaining vertices and triangles. Normals are the area weighted face normals
+GLuint Simplifier::output(std::vector<Vertex>& vertices, std::vector<GLuint>& indices) const
+{
+	const GLuint unused = 0xFFFFFFFF;
+	std::vector<GLuint> remap(positions.size(), unused);
+
+	vertices.clear();
+	indices.clear();
+	indices.reserve(3 * size_t(liveTriangles));
+	for (size_t t = 0; t < triangleAlive.size(); t++)
+	{
+		if (!triangleAlive[t]) continue;
+
+		glm::vec3 p0 = positions[triangles[3 * t]], p1 = positions[triangles[3 * t + 1]], p2 = positions[triangles[3 * t + 2]];
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		for (GLuint k = 0; k < 3; k++)
+		{
+			GLuint v = triangles[3 * t + k];
+			if (remap[v] == unused) {
+				remap[v] = GLuint(vertices.size());
+				vertices.push_back(Vertex(positions[v]));
+			}
+			vertices[remap[v]].Normal += normal;
+			indices.push_back(remap[v]);
+		}
+	}
+
+	for (Vertex& v : vertices)
+	{
+		float length = glm::length(v.Normal);
+		if (length > 0.0f) v.Normal /= length;
+	}
+	return GLuint(indices.size() / 3);
+}
+
+GLuint MeshSimplifier::simplify(const HalfEdgeMesh& mesh, float maxError,
+	std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	Simplifier simplifier(mesh);
+	simplifier.run(double(maxError) * double(maxError));
+	GLuint ntris = simplifier.output(vertices, indices);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> time = endTime - startTime;
+	printf("simplify: %u -> %u triangles, %u -> %u vertices (%u collapses within %g) in %.2f ms\n",
+		mesh.numFaces(), ntris, mesh.numVertices(), GLuint(vertices.size()), simplifier.numCollapses(),
+		maxError, time.count());
+
+	return ntris;
+}
+
+// Every pass measures how far each triangle is outside the surface, and moves each vertex inwards along its
+// normal by the most that one of its triangles is outside. The vertices move by the distance their triangles
+// are out, so the result stays as close to the surface as the sampling allows
+SurfaceDistance::Range MeshSimplifier::shrinkInside(const SurfaceDistance& surface,
+	std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	std::vector<SurfaceDistance::Range> triangleRanges;
+	std::vector<float> inset(vertices.size());
+	const float tolerance = INSET_TOLERANCE * surface.boundsDiagonal();
+	float largestInset = 0.0f;
+	int pass = 0;
+
+	for (; pass < MAX_INSET_PASSES; pass++)
+	{
+		surface.triangleDistancesFrom(SurfaceDistance(vertices, indices), triangleRanges);
+
+		std::fill(inset.begin(), inset.end(), 0.0f);
+		bool outside = false;
+		for (size_t t = 0; t < triangleRanges.size(); t++)
+		{
+			float out = triangleRanges[t].max;
+			if (out <= tolerance) continue;
+
+			outside = true;
+			for (int k = 0; k < 3; k++) inset[indices[3 * t + k]] = std::max(inset[indices[3 * t + k]], out);
+		}
+		if (!outside) break;
+
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			vertices[v].Position -= vertices[v].Normal * inset[v];
+			largestInset = std::max(largestInset, inset[v]);
+		}
+	}
+
+	SurfaceDistance::Range range = surface.distancesFrom(SurfaceDistance(vertices, indices));
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> time = endTime - startTime;
+	printf("shrinkInside: moved in by up to %g in %d passes, now %g to %g from the surface, in %.2f ms\n",
+		largestInset, pass, range.min, range.max, time.count());
+
+	return range;
+}
@@ -0,0 +1,36 @@
+/*
+ *	Quadric error metric simplification, used to build low-polygon proxies of occluders for the
+ *	shadow volume passes. Edges are collapsed in order of increasing quadric error (Garland and Heckbert)
+ *	until the next collapse would move the surface further than the error bound. Collapses that would
+ *	break the manifold (link condition) or flip a triangle are skipped, so a closed mesh stays closed
+ *	and its half-edge mesh generates valid adjacency.
+ */
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "SurfaceDistance.h"
+
+#include <vector>
+
+struct Vertex;
+class HalfEdgeMesh;
+
+class MeshSimplifier {
+public:
+	// Simplify the welded triangles of a half-edge mesh. maxError is the largest root mean square distance,
+	// in model units, that a collapsed vertex may be from the planes of the triangles it replaces.
+	// The result has the positions and smooth normals of the kept vertices and one index per corner.
+	// Returns the number of triangles
+	static GLuint simplify(const HalfEdgeMesh& mesh, float maxError,
+		std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	// Move the vertices of a simplified mesh inwards along their normals until no point sampled on its triangles
+	// is outside the surface it was simplified from, so that it fits inside a closed surface. Returns the signed
+	// distances of the result from the surface
+	static SurfaceDistance::Range shrinkInside(const SurfaceDistance& surface,
+		std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+};
+#endif
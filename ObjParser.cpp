@@ -0,0 +1,452 @@
+#include "ObjParser.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Number parsing
+// --------------
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char* skipSpaces(const char* p, const char* end)
+{
+	while (p < end && isSpace(*p)) p++;
+	return p;
+}
+
+// Slow path: copy the token and let strtof handle it (long mantissas, large exponents, inf/nan)
+static const char* parseFloatSlow(const char* p, const char* end, float& value)
+{
+	char buffer[64];
+	size_t n = 0;
+	while (p + n < end && n < sizeof(buffer) - 1 && !isSpace(p[n]) && p[n] != '\n') {
+		buffer[n] = p[n];
+		n++;
+	}
+	buffer[n] = '\0';
+
+	char* parsedEnd;
+	value = strtof(buffer, &parsedEnd);
+	if (parsedEnd == buffer) return nullptr;
+	return p + (parsedEnd - buffer);
+}
+
+// Parse a float starting at p. Returns the position after the number, or nullptr if there is none.
+// Numbers with at most 2^24 as mantissa and a decimal exponent within +-10 are exact in float
+// arithmetic, so a single multiplication or division rounds them exactly like strtof does.
+// Everything else falls back to strtof.
+static const char* parseFloat(const char* p, const char* end, float& value)
+{
+	static const float powersOf10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+	p = skipSpaces(p, end);
+	const char* start = p;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	uint32_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+	bool exact = true;
+
+	while (p < end && isDigit(*p)) {
+		if (significantDigits < 9) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) significantDigits++;
+		} else {
+			exact = false;
+		}
+		anyDigits = true;
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && isDigit(*p)) {
+			if (significantDigits < 9) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) significantDigits++;
+				exponent--;
+			} else {
+				exact = false;
+			}
+			anyDigits = true;
+			p++;
+		}
+	}
+	if (!anyDigits) return parseFloatSlow(start, end, value);
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* q = p + 1;
+		bool negativeExponent = false;
+		if (q < end && (*q == '-' || *q == '+')) {
+			negativeExponent = (*q == '-');
+			q++;
+		}
+		if (q < end && isDigit(*q)) {
+			int e = 0;
+			while (q < end && isDigit(*q)) {
+				if (e < 10000) e = e * 10 + (*q - '0');
+				q++;
+			}
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	// The number must end here, otherwise leave it to strtof
+	if (p < end && !isSpace(*p) && *p != '\n') exact = false;
+
+	if (!exact || mantissa > (1u << 24) || exponent < -10 || exponent > 10) {
+		return parseFloatSlow(start, end, value);
+	}
+
+	float f = float(mantissa);
+	f = (exponent < 0) ? f / powersOf10[-exponent] : f * powersOf10[exponent];
+	value = negative ? -f : f;
+	return p;
+}
+
+// Parse an integer starting at p (no leading spaces). Returns the position after it, or nullptr.
+// Values that do not fit in 32 bits are rejected instead of wrapping around to a valid index
+static const char* parseInt(const char* p, const char* end, int& value)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+	if (p >= end || !isDigit(*p)) return nullptr;
+
+	int64_t v = 0;
+	while (p < end && isDigit(*p)) {
+		v = v * 10 + (*p - '0');
+		if (v > INT32_MAX) return nullptr;
+		p++;
+	}
+	value = int(negative ? -v : v);
+	return p;
+}
+
+// Parse a "v/t/n" index triplet. Indices are converted from 1-based or negative (relative) to zero-based.
+// Relative indices are resolved against counts, and flagged in the bits of relativeMask
+static const char* parseIndexTriplet(const char* p, const char* end, const int counts[3], int out[3], int& relativeMask)
+{
+	relativeMask = 0;
+	p = skipSpaces(p, end);
+	for (int k = 0; k < 3; k++)
+	{
+		if (k > 0) {
+			if (p >= end || *p != '/') return nullptr;
+			p++;
+		}
+		int idx;
+		p = parseInt(p, end, idx);
+		if (!p) return nullptr;
+		if (idx < 0) relativeMask |= (1 << k);
+		out[k] = (idx < 0) ? counts[k] + idx : idx - 1;
+	}
+	return p;
+}
+
+// Hash of the v/t/n indices of a face corner
+static uint32_t hashCorner(const int* corner)
+{
+	uint64_t h = uint32_t(corner[0]);
+	h = h * 0x9E3779B97F4A7C15ULL ^ uint32_t(corner[1]);
+	h = h * 0x9E3779B97F4A7C15ULL ^ uint32_t(corner[2]);
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	return uint32_t(h ^ (h >> 32));
+}
+
+// Print the error message for a malformed element, numbered from 1 like the original loader
+static void printElementError(const char* type, int number)
+{
+	printf("Malformed %s data found at %s %d.\n", type, type, number);
+	printf("Aborting.\n");
+}
+
+// ***************************************************************************
+// * PUBLIC
+// ***************************************************************************
+
+bool ObjParser::parse(const char* filename, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, float weldEpsilon, unsigned threads)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(filename);
+	if (!file.isOpen()) {
+		fprintf(stderr, "%s: %s\n", "File not found", filename);
+		return false;
+	}
+
+	const char* begin = file.data();
+	const char* end = begin + file.size();
+
+	// One chunk per thread, but no chunks smaller than MIN_CHUNK_SIZE
+	unsigned nchunks = unsigned(std::min<size_t>(Parallel::numThreads(threads), file.size() / MIN_CHUNK_SIZE + 1));
+
+	// Split the file at the line break after every even split point
+	std::vector<const char*> bounds(nchunks + 1);
+	bounds[0] = begin;
+	bounds[nchunks] = end;
+	for (unsigned c = 1; c < nchunks; c++)
+	{
+		const char* p = std::max(begin + file.size() * c / nchunks, bounds[c - 1]);
+		const char* lineEnd = (p < end) ? (const char*)memchr(p, '\n', end - p) : nullptr;
+		bounds[c] = lineEnd ? lineEnd + 1 : end;
+	}
+
+	// Parse the chunks in parallel
+	std::vector<ObjData> chunks(nchunks);
+	Parallel::forEachThread(nchunks, [&](unsigned c) {
+		parseRange(bounds[c], bounds[c + 1], chunks[c]);
+	});
+
+	// Stitch the chunks together and build the triangles
+	ObjData data;
+	bool ok = stitchChunks(chunks, data, nchunks);
+	ok = ok && buildTriangles(data, vertices, indices, nchunks);
+
+	// Corners with different indices can still have equal vertices
+	GLuint nunique = ok ? MeshOptimizer::indexVertices(vertices, indices, nchunks) : 0;
+
+	// Nearly coincident vertices are snapped together and merged if all their attributes now match
+	GLuint nwelded = ok ? MeshOptimizer::weldPositions(vertices, weldEpsilon) : 0;
+	if (nwelded > 0) nunique = MeshOptimizer::indexVertices(vertices, indices, nchunks);
+
+	if (!ok) {
+		fprintf(stderr, "%s: %s\n", "Mesh read error", "No mesh data generated");
+		vertices.clear();
+		indices.clear();
+		return false;
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration<double>(endTime - startTime).count();
+	double megabytes = file.size() / (1024.0 * 1024.0);
+
+	printf("loadObj(\"%s\"): found %d vertices, %d normals, %d texcoords, %d faces.\n",
+		filename, int(data.verts.size() / 3), int(data.normals.size() / 3),
+		int(data.texcoords.size() / 2), int(data.faces.size() / 9));
+	printf("loadObj(\"%s\"): %u unique vertices for %d corners, %u vertices welded within %g.\n",
+		filename, nunique, int(indices.size()), nwelded, weldEpsilon);
+	printf("loadObj(\"%s\"): parsed %.2f MB on %u threads in %.2f ms (%.1f MB/s)\n",
+		filename, megabytes, nchunks, seconds * 1000.0, seconds > 0.0 ? megabytes / seconds : 0.0);
+
+	return true;
+}
+
+// ***************************************************************************
+// * PRIVATE
+// ***************************************************************************
+
+// Parse the lines in [begin, end). Parsing stops at the first malformed line, which is recorded in data.error
+void ObjParser::parseRange(const char* begin, const char* end, ObjData& data)
+{
+	const char* p = begin;
+
+	while (p < end)
+	{
+		const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+		if (!lineEnd) lineEnd = end;
+
+		// The tag is the first word on the line
+		const char* tag = skipSpaces(p, lineEnd);
+		const char* tagEnd = tag;
+		while (tagEnd < lineEnd && !isSpace(*tagEnd)) tagEnd++;
+		size_t tagLength = tagEnd - tag;
+
+		if (tagLength == 1 && tag[0] == 'v') {
+			float xyz[3];
+			const char* q = tagEnd;
+			for (int k = 0; k < 3 && q; k++) q = parseFloat(q, lineEnd, xyz[k]);
+			if (!q) {
+				data.error = ObjElement::Vertex;
+				data.errorElement = int(data.verts.size() / 3);
+				return;
+			}
+			data.verts.insert(data.verts.end(), xyz, xyz + 3);
+		}
+		else if (tagLength == 2 && tag[0] == 'v' && tag[1] == 'n') {
+			float xyz[3];
+			const char* q = tagEnd;
+			for (int k = 0; k < 3 && q; k++) q = parseFloat(q, lineEnd, xyz[k]);
+			if (!q) {
+				data.error = ObjElement::Normal;
+				data.errorElement = int(data.normals.size() / 3);
+				return;
+			}
+			data.normals.insert(data.normals.end(), xyz, xyz + 3);
+		}
+		else if (tagLength == 2 && tag[0] == 'v' && tag[1] == 't') {
+			float st[2];
+			const char* q = tagEnd;
+			for (int k = 0; k < 2 && q; k++) q = parseFloat(q, lineEnd, st[k]);
+			if (!q) {
+				data.error = ObjElement::TexCoord;
+				data.errorElement = int(data.texcoords.size() / 2);
+				return;
+			}
+			data.texcoords.insert(data.texcoords.end(), st, st + 2);
+		}
+		else if (tagLength == 1 && tag[0] == 'f') {
+			// Counts of vertices, texcoords and normals so far in this chunk, for relative indices
+			const int counts[3] = { int(data.verts.size() / 3), int(data.texcoords.size() / 2), int(data.normals.size() / 3) };
+
+			// Only the first three corners are used, like the original loader
+			int corners[9];
+			int relativeMask[3] = { 0, 0, 0 };
+			const char* q = tagEnd;
+			for (int k = 0; k < 3 && q; k++) q = parseIndexTriplet(q, lineEnd, counts, &corners[3 * k], relativeMask[k]);
+			if (!q) {
+				data.error = ObjElement::Face;
+				data.errorElement = int(data.faces.size() / 9);
+				return;
+			}
+
+			// Relative indices are only resolved within the chunk, remember them for stitching
+			for (int k = 0; k < 9; k++)
+			{
+				if (relativeMask[k / 3] & (1 << (k % 3))) data.relativeIndices.push_back(data.faces.size() + k);
+			}
+			data.faces.insert(data.faces.end(), corners, corners + 9);
+		}
+
+		p = lineEnd + 1;
+	}
+}
+
+// Concatenate the chunks in file order. The element counts of the earlier chunks (a prefix sum)
+// give the global numbering, which is needed for relative indices and error messages
+bool ObjParser::stitchChunks(std::vector<ObjData>& chunks, ObjData& data, unsigned threads)
+{
+	const size_t nchunks = chunks.size();
+	std::vector<size_t> vertOffset(nchunks + 1, 0), normalOffset(nchunks + 1, 0);
+	std::vector<size_t> texOffset(nchunks + 1, 0), faceOffset(nchunks + 1, 0);
+
+	for (size_t c = 0; c < nchunks; c++)
+	{
+		const ObjData &chunk = chunks[c];
+
+		// Report the first malformed element in the file
+		if (chunk.error != ObjElement::None) {
+			switch (chunk.error) {
+			case ObjElement::Vertex: printElementError("vertex", int(vertOffset[c] / 3) + chunk.errorElement + 1); break;
+			case ObjElement::Normal: printElementError("normal", int(normalOffset[c] / 3) + chunk.errorElement + 1); break;
+			case ObjElement::TexCoord: printElementError("texcoord", int(texOffset[c] / 2) + chunk.errorElement + 1); break;
+			default: printElementError("face", int(faceOffset[c] / 9) + chunk.errorElement + 1); break;
+			}
+			return false;
+		}
+
+		vertOffset[c + 1] = vertOffset[c] + chunk.verts.size();
+		normalOffset[c + 1] = normalOffset[c] + chunk.normals.size();
+		texOffset[c + 1] = texOffset[c] + chunk.texcoords.size();
+		faceOffset[c + 1] = faceOffset[c] + chunk.faces.size();
+	}
+
+	data.verts.resize(vertOffset[nchunks]);
+	data.normals.resize(normalOffset[nchunks]);
+	data.texcoords.resize(texOffset[nchunks]);
+	data.faces.resize(faceOffset[nchunks]);
+
+	Parallel::forChunks(nchunks, threads, [&](size_t first, size_t last, unsigned) {
+		for (size_t c = first; c < last; c++)
+		{
+			ObjData &chunk = chunks[c];
+
+			// Offsets of the v, t and n indices of this chunk
+			const int offset[3] = { int(vertOffset[c] / 3), int(texOffset[c] / 2), int(normalOffset[c] / 3) };
+			for (size_t i : chunk.relativeIndices)
+			{
+				chunk.faces[i] += offset[i % 3];
+			}
+
+			std::copy(chunk.verts.begin(), chunk.verts.end(), data.verts.begin() + vertOffset[c]);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + normalOffset[c]);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), data.texcoords.begin() + texOffset[c]);
+			std::copy(chunk.faces.begin(), chunk.faces.end(), data.faces.begin() + faceOffset[c]);
+
+			chunk = ObjData(); // Free the chunk early
+		}
+	});
+
+	return true;
+}
+
+// Corners with the same v/t/n indices share one vertex. Checking the indices is much cheaper than
+// comparing the vertices, and the duplicate vertices are never built
+bool ObjParser::buildTriangles(const ObjData& data, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, unsigned threads)
+{
+	const int numverts = int(data.verts.size() / 3);
+	const int numtexcoords = int(data.texcoords.size() / 2);
+	const int numnormals = int(data.normals.size() / 3);
+	const size_t numfaces = data.faces.size() / 9;
+	const int *corners = data.faces.data();
+
+	// First face with an index out of range, per thread
+	std::vector<size_t> badFace(Parallel::numThreads(threads), numfaces);
+
+	Parallel::forChunks(numfaces, threads, [&](size_t first, size_t last, unsigned t) {
+		for (size_t i = 3 * first; i < 3 * last; i++)
+		{
+			int v = corners[3 * i];
+			int tc = corners[3 * i + 1];
+			int n = corners[3 * i + 2];
+
+			if (v < 0 || v >= numverts || tc < 0 || tc >= numtexcoords || n < 0 || n >= numnormals) {
+				badFace[t] = i / 3;
+				return;
+			}
+		}
+	});
+
+	size_t firstBadFace = *std::min_element(badFace.begin(), badFace.end());
+	if (firstBadFace < numfaces) {
+		printElementError("face", int(firstBadFace) + 1);
+		return false;
+	}
+
+	// The index array:
+	std::vector<GLuint> firsts;
+	GLuint nunique = MeshOptimizer::findUnique(3 * numfaces,
+		[&](size_t i) { return hashCorner(&corners[3 * i]); },
+		[&](size_t i, size_t j) { return std::memcmp(&corners[3 * i], &corners[3 * j], 3 * sizeof(int)) == 0; },
+		indices, firsts, threads);
+
+	vertices.resize(nunique);
+	Parallel::forChunks(nunique, threads, [&](size_t begin, size_t end, unsigned) {
+		for (size_t u = begin; u < end; u++)
+		{
+			const int *corner = &corners[3 * firsts[u]];
+			const float *pos = &data.verts[3 * corner[0]];
+			const float *tex = &data.texcoords[2 * corner[1]];
+			const float *nor = &data.normals[3 * corner[2]];
+			vertices[u] = Vertex{ glm::vec3(pos[0], pos[1], pos[2]), glm::vec3(nor[0], nor[1], nor[2]), glm::vec2(tex[0], tex[1]) };
+		}
+	});
+
+	return true;
+}
@@ -0,0 +1,56 @@
+/*
+ *	Fast OBJ parser. The file is memory mapped, split into chunks at line boundaries and
+ *	the chunks are parsed in place on separate threads, with hand-written number parsing
+ *	instead of sscanf. Faces are expected as triangles with v/t/n indices, like the
+ *	original loader in MeshCreator.
+ */
+
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <vector>
+#include <cstddef>
+
+struct Vertex;
+
+class ObjParser {
+public:
+	// Parse an OBJ file into an indexed triangle list with unique vertices, using the given
+	// number of threads (0 = all cores). Positions closer than weldEpsilon are welded (0 = exact matches only).
+	// Returns false (and prints an error) if the file is missing or malformed
+	static bool parse(const char* filename, std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+		float weldEpsilon = 0.0f, unsigned threads = 0);
+
+private:
+	// Files are not split into chunks smaller than this
+	static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	// The kinds of elements that can be malformed
+	enum class ObjElement { None, Vertex, Normal, TexCoord, Face };
+
+	// Data read from (a part of) an OBJ file
+	struct ObjData {
+		std::vector<float> verts;		// 3 floats per vertex
+		std::vector<float> normals;		// 3 floats per normal
+		std::vector<float> texcoords;	// 2 floats per texcoord
+		std::vector<int> faces;			// 9 zero-based indices per face: v, t, n for each corner
+
+		std::vector<size_t> relativeIndices;	// Positions in faces of relative indices, only resolved within the chunk
+
+		ObjElement error = ObjElement::None;	// First malformed element, if any
+		int errorElement = 0;					// Its zero-based number within the chunk
+	};
+
+	// Parse all lines in [begin, end). Malformed data is recorded in data.error
+	static void parseRange(const char* begin, const char* end, ObjData& data);
+
+	// Concatenate the parsed chunks in file order. Returns false if any chunk is malformed
+	static bool stitchChunks(std::vector<ObjData>& chunks, ObjData& data, unsigned threads);
+
+	// Build the indexed triangle list from the parsed data, with one vertex per distinct v/t/n triplet.
+	// Returns false on indices out of range
+	static bool buildTriangles(const ObjData& data, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, unsigned threads);
+};
+#endif
@@ -0,0 +1,55 @@
+/*
+ *	Small helpers for splitting CPU work over a number of std::threads.
+ *	Every helper runs the work on the calling thread when only one thread is used.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace Parallel {
+
+	// Number of threads to use. 0 means one thread per hardware core
+	inline unsigned numThreads(unsigned requested = 0)
+	{
+		if (requested > 0) return requested;
+		unsigned hw = std::thread::hardware_concurrency();
+		return hw > 0 ? hw : 1;
+	}
+
+	// Call func(threadIdx) once on each of n threads and wait for all of them
+	template <typename Func>
+	void forEachThread(unsigned n, Func func)
+	{
+		if (n <= 1) {
+			func(0u);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		threads.reserve(n - 1);
+		for (unsigned t = 1; t < n; t++)
+		{
+			threads.emplace_back(func, t);
+		}
+		func(0u);
+		for (auto &thread : threads) thread.join();
+	}
+
+	// Split [0, count) into n contiguous chunks and call func(begin, end, chunkIdx) for each on its own thread
+	template <typename Func>
+	void forChunks(size_t count, unsigned n, Func func)
+	{
+		n = unsigned(std::max<size_t>(1, std::min<size_t>(n, count)));
+		forEachThread(n, [&](unsigned t) {
+			size_t begin = count * t / n;
+			size_t end = count * (t + 1) / n;
+			func(begin, end, t);
+		});
+	}
+}
+#endif
@@ -49,6 +49,24 @@ void Shader::create(const char* vertexPath, const char* fragmentPath, const char
 	compile(vShaderCode, fShaderCode, gShaderCode);
 }
 
+void Shader::create(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const char* defines)
+{
+	// 1. retrieve the vertex/fragment source code from filePath and add the defines
+	// ---------------------------------------------------------
+
+	std::string vFileContent = readShaderFile(vertexPath);
+	std::string fFileContent = readShaderFile(fragmentPath);
+	std::string gFileContent = readShaderFile(geometryPath);
+
+	insertDefines(vFileContent, defines);
+	insertDefines(fFileContent, defines);
+	insertDefines(gFileContent, defines);
+
+	// 2. compile shaders
+	// ------------------
+	compile(vFileContent.c_str(), fFileContent.c_str(), gFileContent.c_str());
+}
+
 // use/activate the shader
 void Shader::use()
 {
@@ -155,6 +173,18 @@ std::string Shader::readShaderFile(const char* shaderPath)
 	return shaderCode;
 }
 
+// Insert defines after the #version line, which has to come first in the source.
+// The #line directive keeps the line numbers of compile errors matching the file
+void Shader::insertDefines(std::string& source, const char* defines)
+{
+	size_t lineEnd = source.find('\n');
+	if (lineEnd == std::string::npos) {
+		source += '\n';
+		lineEnd = source.size() - 1;
+	}
+	source.insert(lineEnd + 1, std::string(defines) + "#line 2\n");
+}
+
 // compile shader program (with possiblity of using geometry shader)
 // ------------------------------------------------------------------------
 void Shader::compile(const char * vShaderCode, const char * fShaderCode, const char * gShaderCode)
@@ -181,8 +211,8 @@ void Shader::compile(const char * vShaderCode, const char * fShaderCode, const c
 		checkCompileErrors(fragment, "GEOMETRY");
 	}
 
-	// shader Program
-	ID = glCreateProgram();
+	// shader Program (replaces any previous program)
+	ID = GLProgram::create();
 	glAttachShader(ID, vertex);
 	glAttachShader(ID, fragment);
 	if (gShaderCode) glAttachShader(ID, geometry);
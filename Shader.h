@@ -11,6 +11,8 @@
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
 #include <glm/glm.hpp>
 
+#include "GLHandle.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -20,16 +22,26 @@ class Shader
 {
 public:
 
-	unsigned int ID;	// the program ID
+	GLProgram ID;	// the program ID, deleted with the shader
 
 	// constructor reads and builds the shader
 	Shader() = default;
+
+	// shaders own their program, so they can be moved but not copied
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+	Shader(Shader&&) = default;
+	Shader& operator=(Shader&&) = default;
+
 	Shader(const char* vertexPath, const char* fragmentPath);
 	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath);
 
 	void create(const char* vertexPath, const char* fragmentPath);
 	void create(const char* vertexPath, const char* fragmentPath, const char* geometryPath);
 
+	// create a variant of a shader: the defines (e.g. "#define NO_CAPS\n") are inserted after the #version line of every stage
+	void create(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const char* defines);
+
 	// use/activate the shader
 	void use();
 
@@ -49,6 +61,7 @@ public:
 
 private:
 	std::string readShaderFile(const char* shaderPath);
+	void insertDefines(std::string& source, const char* defines);
 	void compile(const char * vShaderCode, const char * fShaderCode, const char * gShaderCode = nullptr);
 	void checkCompileErrors(unsigned int shader, std::string type);
 };
@@ -0,0 +1,114 @@
+#include "ShadowVolume.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The sphere is scaled by the largest axis scale of the model matrix
+void ShadowVolume::boundingSphere(const Bounds& bounds, const glm::mat4& model, glm::vec3& center, float& radius)
+{
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	center = glm::vec3(model * glm::vec4(0.5f * (bounds.min + bounds.max), 1.0f));
+	radius = scale * 0.5f * glm::length(bounds.max - bounds.min);
+}
+
+// A point on the near rectangle is in shadow if the segment from it to the light passes through the occluder,
+// so the volume can only reach the near plane if the occluder intersects the convex hull of the light and
+// the rectangle. The hull is bounded by the near plane and one plane through the light and every side
+bool ShadowVolume::needsZFail(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, const glm::mat4& viewProjection)
+{
+	// Corners of the near rectangle in world space, in order around it
+	glm::mat4 inverse = glm::inverse(viewProjection);
+	const glm::vec2 ndc[4] = { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) };
+	glm::vec3 corners[4];
+	glm::vec3 nearCenter(0.0f);
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec4 p = inverse * glm::vec4(ndc[i], -1.0f, 1.0f);
+		corners[i] = glm::vec3(p) / p.w;
+		nearCenter += 0.25f * corners[i];
+	}
+
+	glm::vec3 center;
+	float radius;
+	boundingSphere(bounds, model, center, radius);
+	radius *= 1.01f; // Margin for the rounding of the planes
+
+	// Near plane, facing the light. A light in the near plane leaves no pyramid to test against
+	glm::vec3 nearNormal = glm::cross(corners[1] - corners[0], corners[3] - corners[0]);
+	float nearSize = glm::length(nearNormal);
+	if (nearSize == 0.0f) return true;
+	nearNormal /= nearSize;
+
+	float lightDistance = glm::dot(nearNormal, lightPos - corners[0]);
+	if (std::abs(lightDistance) <= 1e-6f * std::sqrt(nearSize)) return true;
+	if (lightDistance < 0.0f) nearNormal = -nearNormal;
+
+	if (glm::dot(nearNormal, center - corners[0]) < -radius) return false;
+
+	// Sides, facing the inside of the pyramid
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec3 normal = glm::cross(corners[i] - lightPos, corners[(i + 1) % 4] - lightPos);
+		float length = glm::length(normal);
+		if (length == 0.0f) return true;
+		normal /= length;
+		if (glm::dot(normal, nearCenter - lightPos) < 0.0f) normal = -normal;
+
+		if (glm::dot(normal, center - lightPos) < -radius) return false;
+	}
+	return true;
+}
+
+// The swept sphere is outside a frustum plane if the sphere is outside it and every point of the sphere moves
+// away from the plane when pushed away from the light. With signed distances d to the plane (inside positive)
+// that is d(center) < -radius and d(center) + radius <= d(light)
+bool ShadowVolume::mayBeVisible(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, const glm::mat4& viewProjection)
+{
+	glm::vec3 center;
+	float radius;
+	boundingSphere(bounds, model, center, radius);
+
+	// Left, right, bottom, top and near planes from the rows of the matrix (Gribb and Hartmann)
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	const glm::vec4 planes[5] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2] };
+
+	for (const glm::vec4& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		if (length == 0.0f) continue;
+
+		float centerDistance = (glm::dot(glm::vec3(plane), center) + plane.w) / length;
+		float lightDistance = (glm::dot(glm::vec3(plane), lightPos) + plane.w) / length;
+		if (centerDistance < -radius && centerDistance + radius <= lightDistance) return false;
+	}
+	return true;
+}
+
+bool ShadowVolume::isInRange(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, float lightRange)
+{
+	glm::vec3 center;
+	float radius;
+	boundingSphere(bounds, model, center, radius);
+	return glm::length(center - lightPos) - radius <= lightRange;
+}
+
+// The volume is extruded from the light, so every vertex of the back cap is in the cone from the light around
+// the bounding sphere. With half angle a of that cone, every point of a flat cap between vertices at distance
+// d from the light is at least d * cos(a) from it, which is beyond the range for d = range / cos(a)
+float ShadowVolume::extrusionDistance(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, float lightRange)
+{
+	glm::vec3 center;
+	float radius;
+	boundingSphere(bounds, model, center, radius);
+
+	float distance = glm::length(center - lightPos);
+	float sine = radius / distance;
+	if (!(sine < 0.999f)) return 0.0f;
+
+	float cosine = std::sqrt(1.0f - sine * sine);
+	return lightRange / cosine;
+}
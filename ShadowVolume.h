@@ -0,0 +1,40 @@
+/*
+ *	CPU-side tests for rendering the shadow volume of an occluder. Volumes that can not reach the view
+ *	frustum are not rendered at all. Volumes that can not contain any point of the camera's near plane are
+ *	rendered with z-pass and without caps. Only the others need the capped z-fail volume, which is robust
+ *	when the camera is inside the shadow. For a light with a limited range, the volumes can end just beyond
+ *	that range instead of at infinity, and occluders out of range cast no volume.
+ */
+
+#ifndef SHADOWVOLUME_H
+#define SHADOWVOLUME_H
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+class ShadowVolume {
+public:
+	// Check if the shadow volume of an occluder cast by a point light may intersect the near plane rectangle
+	// of the camera. This is the case if the occluder intersects the pyramid between the light and the near
+	// rectangle, which is tested with the bounding sphere of the occluder. bounds are in model space
+	static bool needsZFail(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, const glm::mat4& viewProjection);
+
+	// Check if the shadow volume of an occluder cast by a point light may reach the view frustum. The volume is
+	// bounded by the bounding sphere of the occluder swept away from the light to infinity. The far plane is
+	// not tested, since the volumes are rendered with depth clamping. bounds are in model space
+	static bool mayBeVisible(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, const glm::mat4& viewProjection);
+
+	// Check if any part of an occluder is within the range of a point light. Occluders out of range can only
+	// shadow points that the light does not reach. bounds are in model space
+	static bool isInRange(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, float lightRange);
+
+	// Distance from a point light that the volume of an occluder is extruded to, so that its back cap lies
+	// beyond the range of the light. Returns 0, for extrusion to infinity, if the light is inside the bounding
+	// sphere of the occluder. bounds are in model space
+	static float extrusionDistance(const Bounds& bounds, const glm::mat4& model, const glm::vec3& lightPos, float lightRange);
+
+	// Bounding sphere in world space of model space bounds
+	static void boundingSphere(const Bounds& bounds, const glm::mat4& model, glm::vec3& center, float& radius);
+};
+#endif
@@ -0,0 +1,43 @@
+#include "ShadowVolumeBuffer.h"
+#include "GLBufferFill.h"
+
+#include <algorithm>
+
+// The store grows to twice the needed size, so volumes that grow a little from frame to frame do not
+// reallocate it every time. The mapping invalidates the whole store, which orphans it
+void ShadowVolumeBuffer::upload(const SilhouetteExtractor& volumes)
+{
+	if (VAO == 0) {
+		VAO = GLVertexArray::create();
+		VBO = GLBuffer::create();
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+		glBindVertexArray(0);
+	}
+
+	size_t count = volumes.totalVertices();
+	if (count == 0) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	if (count > capacity) {
+		capacity = std::max(count, 2 * capacity);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+	}
+
+	writeBuffer(GL_ARRAY_BUFFER, count * sizeof(glm::vec4), [&](unsigned char* out) {
+		volumes.write(reinterpret_cast<glm::vec4*>(out));
+	});
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ShadowVolumeBuffer::draw(const SilhouetteExtractor& volumes, size_t caster) const
+{
+	if (VAO == 0 || volumes.numVertices(caster) == 0) return;
+
+	glBindVertexArray(VAO);
+	glDrawArrays(GL_TRIANGLES, volumes.firstVertex(caster), volumes.numVertices(caster));
+	glBindVertexArray(0);
+}
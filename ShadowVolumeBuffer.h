@@ -0,0 +1,32 @@
+/*
+ *	Streaming vertex buffer for the shadow volumes generated on the CPU. The volumes of every frame are
+ *	written straight into the mapped buffer by SilhouetteExtractor, and each occluder's volume is drawn as
+ *	plain GL_TRIANGLES, so no geometry shader is involved. The store only grows, and is orphaned on every
+ *	upload so the driver does not wait for the draws of the previous frame.
+ */
+
+#ifndef SHADOWVOLUMEBUFFER_H
+#define SHADOWVOLUMEBUFFER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "GLHandle.h"
+#include "SilhouetteExtractor.h"
+
+class ShadowVolumeBuffer {
+public:
+	// Write the volumes of the last extraction into the buffer
+	void upload(const SilhouetteExtractor& volumes);
+
+	// Draw the volume of one caster of the last upload. Positions are in world space, at location 0
+	void draw(const SilhouetteExtractor& volumes, size_t caster) const;
+
+	// Bytes of GPU memory held by the buffer
+	size_t memoryBytes() const { return capacity * sizeof(glm::vec4); }
+
+private:
+	GLVertexArray VAO;
+	GLBuffer VBO;
+	size_t capacity = 0; // vertices
+};
+#endif
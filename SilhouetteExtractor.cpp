@@ -0,0 +1,157 @@
+#include "SilhouetteExtractor.h"
+#include "Parallel.h"
+
+#include <chrono>
+
+const float SilhouetteExtractor::EPSILON = 0.01f;
+
+void SilhouetteExtractor::extract(const std::vector<ShadowCaster>& casters, const glm::vec3& lightPos, unsigned threads)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	casterCount = casters.size();
+	if (volumes.size() < casterCount) volumes.resize(casterCount);
+	light = lightPos;
+
+	Parallel::forChunks(casterCount, Parallel::numThreads(threads), [&](size_t begin, size_t end, unsigned) {
+		for (size_t i = begin; i < end; i++)
+		{
+			extractVolume(casters[i], volumes[i]);
+		}
+	});
+
+	// Place the volumes one after the other
+	vertexCount = 0;
+	for (size_t i = 0; i < casterCount; i++)
+	{
+		volumes[i].first = GLint(vertexCount);
+		vertexCount += volumes[i].count;
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	extractTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void SilhouetteExtractor::write(glm::vec4* out, unsigned threads) const
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	Parallel::forChunks(casterCount, Parallel::numThreads(threads), [&](size_t begin, size_t end, unsigned) {
+		for (size_t i = begin; i < end; i++)
+		{
+			writeVolume(volumes[i], out + volumes[i].first);
+		}
+	});
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	writeTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+// ***************************************************************************
+// * PRIVATE
+// ***************************************************************************
+
+// Faces are classified in world space with the test of the geometry shaders, so both paths extrude the
+// same silhouette. A silhouette edge is kept as the half-edge in its lit face, which gives the winding of the side
+void SilhouetteExtractor::extractVolume(const ShadowCaster& caster, Volume& volume) const
+{
+	volume.positions.clear();
+	volume.litFaces.clear();
+	volume.silhouette.clear();
+	volume.count = 0;
+	volume.mesh = caster.mesh;
+	if (!caster.mesh || caster.mesh->empty()) return;
+
+	const HalfEdgeMesh& mesh = *caster.mesh;
+	volume.positions.resize(mesh.numVertices());
+	for (GLuint v = 0; v < mesh.numVertices(); v++)
+	{
+		volume.positions[v] = glm::vec3(caster.model * glm::vec4(mesh.position(v), 1.0f));
+	}
+
+	std::vector<bool> lit(mesh.numFaces());
+	for (GLuint f = 0; f < mesh.numFaces(); f++)
+	{
+		GLuint h = HalfEdgeMesh::faceHalfEdge(f);
+		const glm::vec3& p0 = volume.positions[mesh.origin(h)];
+		const glm::vec3& p1 = volume.positions[mesh.origin(h + 1)];
+		const glm::vec3& p2 = volume.positions[mesh.origin(h + 2)];
+		lit[f] = glm::dot(glm::cross(p1 - p0, p2 - p1), p0 - light) <= 0.0f;
+		if (lit[f]) volume.litFaces.push_back(f);
+	}
+
+	for (GLuint f : volume.litFaces)
+	{
+		for (GLuint h = HalfEdgeMesh::faceHalfEdge(f); h < HalfEdgeMesh::faceHalfEdge(f) + 3; h++)
+		{
+			GLuint t = mesh.twin(h);
+			if (t == HalfEdgeMesh::INVALID || !lit[HalfEdgeMesh::face(t)]) volume.silhouette.push_back(h);
+		}
+	}
+
+	volume.extrusionDistance = caster.extrusionDistance;
+	volume.frontCap = caster.caps;
+	volume.backCap = caster.caps || caster.extrusionDistance > 0.0f;
+
+	// Two triangles per side, and one triangle per lit face in each cap
+	GLsizei capTriangles = GLsizei(volume.litFaces.size()) * ((volume.frontCap ? 1 : 0) + (volume.backCap ? 1 : 0));
+	volume.count = 3 * (2 * GLsizei(volume.silhouette.size()) + capTriangles);
+}
+
+// The vertices are the ones of ExtrudeEdge and ExtrudeVertex in the geometry shaders. Each side is the
+// triangle strip (start, start extruded, end, end extruded) split into two triangles
+void SilhouetteExtractor::writeVolume(const Volume& volume, glm::vec4* out) const
+{
+	if (volume.count == 0) return;
+	const HalfEdgeMesh& mesh = *volume.mesh;
+
+	auto nearVertex = [&](GLuint v) {
+		const glm::vec3& p = volume.positions[v];
+		return glm::vec4(p + glm::normalize(p - light) * EPSILON, 1.0f);
+	};
+	auto farVertex = [&](GLuint v) {
+		const glm::vec3& p = volume.positions[v];
+		glm::vec3 lightDir = glm::normalize(p - light);
+		if (volume.extrusionDistance <= 0.0f) return glm::vec4(lightDir, 0.0f);
+
+		float extruded = glm::max(volume.extrusionDistance, glm::length(p - light) + EPSILON);
+		return glm::vec4(light + lightDir * extruded, 1.0f);
+	};
+
+	for (GLuint h : volume.silhouette)
+	{
+		glm::vec4 startNear = nearVertex(mesh.origin(h));
+		glm::vec4 startFar = farVertex(mesh.origin(h));
+		glm::vec4 endNear = nearVertex(mesh.target(h));
+		glm::vec4 endFar = farVertex(mesh.target(h));
+
+		*out++ = startNear;
+		*out++ = startFar;
+		*out++ = endNear;
+
+		*out++ = endNear;
+		*out++ = startFar;
+		*out++ = endFar;
+	}
+
+	if (volume.frontCap) {
+		for (GLuint f : volume.litFaces)
+		{
+			GLuint h = HalfEdgeMesh::faceHalfEdge(f);
+			*out++ = nearVertex(mesh.origin(h));
+			*out++ = nearVertex(mesh.origin(h + 1));
+			*out++ = nearVertex(mesh.origin(h + 2));
+		}
+	}
+
+	// The back cap faces away from the light, so its winding is reversed
+	if (volume.backCap) {
+		for (GLuint f : volume.litFaces)
+		{
+			GLuint h = HalfEdgeMesh::faceHalfEdge(f);
+			*out++ = farVertex(mesh.origin(h));
+			*out++ = farVertex(mesh.origin(h + 2));
+			*out++ = farVertex(mesh.origin(h + 1));
+		}
+	}
+}
@@ -0,0 +1,73 @@
+/*
+ *	CPU generation of shadow volumes, as an alternative to the geometry shaders for drivers where those are
+ *	slow. The faces of each occluder are classified against the light, the silhouette edges are found from
+ *	the twins of the half-edge mesh, and the extruded sides and the caps are written as plain triangles.
+ *	The occluders are processed in parallel, first counting the triangles of every volume and then writing
+ *	them, so the output can be written straight into a mapped vertex buffer. Nothing here needs a GL context.
+ */
+
+#ifndef SILHOUETTEEXTRACTOR_H
+#define SILHOUETTEEXTRACTOR_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include "HalfEdgeMesh.h"
+
+#include <vector>
+
+// An occluder whose shadow volume is generated on the CPU
+struct ShadowCaster {
+	const HalfEdgeMesh* mesh = nullptr;	// connectivity and positions in model space
+	glm::mat4 model;
+	float extrusionDistance = 0.0f;		// distance from the light the volume is extruded to, 0 extrudes to infinity
+	bool caps = false;					// front and back caps, needed with z-fail. Finite volumes always get a back cap
+};
+
+class SilhouetteExtractor {
+public:
+	// Offset of the front faces from the occluder along the light direction, as in the geometry shaders
+	static const float EPSILON;
+
+	// Classify the faces and find the silhouettes of the casters as seen from a point light in world space,
+	// split over the given number of threads (0 = all cores). The vertex counts are known afterwards
+	void extract(const std::vector<ShadowCaster>& casters, const glm::vec3& lightPos, unsigned threads = 0);
+
+	// Write the volumes of the last extraction as world space triangles, totalVertices() vertices in order
+	// of the casters. Vertices extruded to infinity have w = 0
+	void write(glm::vec4* out, unsigned threads = 0) const;
+
+	size_t numCasters() const { return casterCount; }
+	GLint firstVertex(size_t caster) const { return volumes[caster].first; }
+	GLsizei numVertices(size_t caster) const { return volumes[caster].count; }
+	size_t totalVertices() const { return vertexCount; }
+	GLuint numSilhouetteEdges(size_t caster) const { return GLuint(volumes[caster].silhouette.size()); }
+
+	// Time of the last extraction and write, in milliseconds
+	double extractMilliseconds() const { return extractTime; }
+	double writeMilliseconds() const { return writeTime; }
+
+private:
+	// Per caster data of the last extraction. Kept between frames, so the vectors keep their capacity
+	struct Volume {
+		const HalfEdgeMesh* mesh = nullptr;
+		std::vector<glm::vec3> positions;	// unique vertices in world space
+		std::vector<GLuint> litFaces;		// faces facing the light
+		std::vector<GLuint> silhouette;		// half-edges of lit faces whose twin is unlit or missing
+		float extrusionDistance = 0.0f;
+		bool frontCap = false, backCap = false;
+		GLint first = 0;
+		GLsizei count = 0;
+	};
+
+	std::vector<Volume> volumes;
+	size_t casterCount = 0;
+	size_t vertexCount = 0;
+	glm::vec3 light = glm::vec3(0.0f);
+	double extractTime = 0.0;
+	mutable double writeTime = 0.0;
+
+	void extractVolume(const ShadowCaster& caster, Volume& volume) const;
+	void writeVolume(const Volume& volume, glm::vec4* out) const;
+};
+#endif
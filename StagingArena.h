@@ -0,0 +1,37 @@
+/*
+ *	Reusable CPU storage for building meshes that are only kept on the GPU. Generators fill the vectors,
+ *	the mesh is uploaded straight from them, and they are cleared but keep their capacity for the next
+ *	mesh. Building many meshes then allocates only for the largest one, instead of allocating and freeing
+ *	the full size of every mesh.
+ */
+
+#ifndef STAGINGARENA_H
+#define STAGINGARENA_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include "Mesh.h"
+
+#include <vector>
+
+class StagingArena {
+public:
+	// Empty vertex and index vectors that keep the capacity of the earlier meshes
+	std::vector<Vertex>& vertices() { vertexData.clear(); return vertexData; }
+	std::vector<GLuint>& indices() { indexData.clear(); return indexData; }
+
+	// Bytes held by the arena
+	size_t capacityBytes() const { return vertexData.capacity() * sizeof(Vertex) + indexData.capacity() * sizeof(GLuint); }
+
+	// Free the storage, e.g. once all meshes of a scene are built
+	void release()
+	{
+		std::vector<Vertex>().swap(vertexData);
+		std::vector<GLuint>().swap(indexData);
+	}
+
+private:
+	std::vector<Vertex> vertexData;
+	std::vector<GLuint> indexData;
+};
+#endif
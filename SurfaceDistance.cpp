@@ -0,0 +1,302 @@
+#include "SurfaceDistance.h"
+#include "HalfEdgeMesh.h"
+#include "Mesh.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Largest number of grid cells along an axis
+static const int MAX_GRID_SIZE = 128;
+
+// Sample spacing of distancesFrom, as a fraction of the bounding box diagonal, and the largest number of
+// sample intervals along a triangle edge
+static const float SAMPLES_PER_DIAGONAL = 128.0f;
+static const int MAX_SUBDIVISION = 16;
+
+// Closest point to p on the triangle abc, from "Real-Time Collision Detection" (Ericson) 5.1.5
+static glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+static bool isFinite(const glm::vec3& p)
+{
+	return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+// ***************************************************************************
+// * PUBLIC
+// ***************************************************************************
+
+SurfaceDistance::SurfaceDistance(const HalfEdgeMesh& mesh)
+{
+	positions.resize(mesh.numVertices());
+	for (GLuint v = 0; v < mesh.numVertices(); v++) positions[v] = mesh.position(v);
+
+	triangles.reserve(mesh.numFaces());
+	for (GLuint f = 0; f < mesh.numFaces(); f++)
+	{
+		GLuint h = HalfEdgeMesh::faceHalfEdge(f);
+		addTriangle(mesh.position(mesh.origin(h)), mesh.position(mesh.origin(h + 1)), mesh.position(mesh.origin(h + 2)));
+	}
+	buildGrid();
+}
+
+SurfaceDistance::SurfaceDistance(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	positions.resize(vertices.size());
+	for (size_t v = 0; v < vertices.size(); v++) positions[v] = vertices[v].Position;
+
+	triangles.reserve(indices.size() / 3);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		addTriangle(vertices[indices[i]].Position, vertices[indices[i + 1]].Position, vertices[indices[i + 2]].Position);
+	}
+	buildGrid();
+}
+
+// The cells are searched in rings of growing Chebyshev distance r around the cell of the point, until the
+// closest triangle found is nearer than the faces of the box of searched cells. Of triangles at (nearly) the same distance, which share the closest edge or
+// vertex, the one whose plane is most nearly facing the point gives the sign
+float SurfaceDistance::signedDistance(const glm::vec3& p) const
+{
+	if (empty()) return std::numeric_limits<float>::max();
+
+	const glm::ivec3 center = cellOf(p);
+
+	float bestDistance2 = std::numeric_limits<float>::max();
+	float bestFacing = -1.0f; // |cos| of the angle between the normal and the direction to the point
+	float bestSide = 0.0f;
+
+	auto testCell = [&](int x, int y, int z) {
+		size_t cell = (size_t(z) * gridSize.y + y) * gridSize.x + x;
+		for (GLuint i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+		{
+			const Triangle& t = triangles[cellTriangles[i]];
+			glm::vec3 d = p - closestPointOnTriangle(p, t.a, t.b, t.c);
+			float distance2 = glm::dot(d, d);
+			float side = glm::dot(d, t.normal);
+			float facing = distance2 > 0.0f ? std::abs(side) / std::sqrt(distance2) : 1.0f;
+
+			float tolerance = 1e-6f * bestDistance2;
+			if (distance2 < bestDistance2 - tolerance || (distance2 <= bestDistance2 + tolerance && facing > bestFacing)) {
+				bestDistance2 = std::min(distance2, bestDistance2);
+				bestFacing = facing;
+				bestSide = side;
+			}
+		}
+	};
+
+	for (int r = 0; ; r++)
+	{
+		for (int z = std::max(center.z - r, 0); z <= std::min(center.z + r, gridSize.z - 1); z++)
+		{
+			for (int y = std::max(center.y - r, 0); y <= std::min(center.y + r, gridSize.y - 1); y++)
+			{
+				// Inside the ring only its two ends along x are new
+				if (std::abs(z - center.z) == r || std::abs(y - center.y) == r) {
+					for (int x = std::max(center.x - r, 0); x <= std::min(center.x + r, gridSize.x - 1); x++) testCell(x, y, z);
+				}
+				else {
+					if (center.x - r >= 0) testCell(center.x - r, y, z);
+					if (center.x + r < gridSize.x) testCell(center.x + r, y, z);
+				}
+			}
+		}
+
+		// Distance from the point to the cells not searched yet
+		float reached = std::numeric_limits<float>::max();
+		for (int k = 0; k < 3; k++)
+		{
+			if (center[k] - r > 0) reached = std::min(reached, p[k] - (gridMin[k] + (center[k] - r) * cellSize));
+			if (center[k] + r + 1 < gridSize[k]) reached = std::min(reached, gridMin[k] + (center[k] + r + 1) * cellSize - p[k]);
+		}
+		if (reached == std::numeric_limits<float>::max() || bestDistance2 <= reached * reached) break;
+	}
+
+	float distance = std::sqrt(bestDistance2);
+	return bestSide < 0.0f ? -distance : distance;
+}
+
+// The other surface is sampled at its vertices, and at the lattice points of its triangles (see sampleTriangle)
+SurfaceDistance::Range SurfaceDistance::distancesFrom(const SurfaceDistance& other, unsigned threads) const
+{
+	if (empty() || other.empty()) return Range();
+
+	const float spacing = other.diagonal / SAMPLES_PER_DIAGONAL;
+	const size_t nverts = other.positions.size();
+	const unsigned n = Parallel::numThreads(threads);
+	std::vector<Range> ranges(n, Range{ std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() });
+
+	Parallel::forChunks(nverts + other.triangles.size(), n, [&](size_t begin, size_t end, unsigned chunk) {
+		Range& range = ranges[chunk];
+		for (size_t i = begin; i < end; i++)
+		{
+			if (i >= nverts) {
+				sampleTriangle(other.triangles[i - nverts], spacing, false, range);
+			}
+			else if (isFinite(other.positions[i])) {
+				float d = signedDistance(other.positions[i]);
+				range.min = std::min(range.min, d);
+				range.max = std::max(range.max, d);
+			}
+		}
+	});
+
+	Range range = ranges[0];
+	for (const Range& r : ranges)
+	{
+		range.min = std::min(range.min, r.min);
+		range.max = std::max(range.max, r.max);
+	}
+	return range.min <= range.max ? range : Range();
+}
+
+void SurfaceDistance::triangleDistancesFrom(const SurfaceDistance& other, std::vector<Range>& ranges, unsigned threads) const
+{
+	ranges.assign(other.triangles.size(), Range());
+	if (empty()) return;
+
+	const float spacing = other.diagonal / SAMPLES_PER_DIAGONAL;
+	Parallel::forChunks(other.triangles.size(), Parallel::numThreads(threads), [&](size_t begin, size_t end, unsigned) {
+		for (size_t i = begin; i < end; i++)
+		{
+			Range range{ std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+			sampleTriangle(other.triangles[i], spacing, true, range);
+			if (range.min <= range.max) ranges[i] = range;
+		}
+	});
+}
+
+float SurfaceDistance::hausdorff(const SurfaceDistance& a, const SurfaceDistance& b, unsigned threads)
+{
+	return std::max(a.distancesFrom(b, threads).largest(), b.distancesFrom(a, threads).largest());
+}
+
+// ***************************************************************************
+// * PRIVATE
+// ***************************************************************************
+
+void SurfaceDistance::addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	glm::vec3 normal = glm::cross(b - a, c - a);
+	float length = glm::length(normal);
+	bool finite = isFinite(a) && isFinite(b) && isFinite(c);
+	triangles.push_back(Triangle{ a, b, c, length > 0.0f ? normal / length : glm::vec3(0.0f), finite });
+}
+
+// The samples are a barycentric lattice that splits the longest edge into intervals no longer than spacing.
+// The corners are left out when the vertices are sampled separately
+void SurfaceDistance::sampleTriangle(const Triangle& t, float spacing, bool corners, Range& range) const
+{
+	if (!t.finite) return;
+
+	float longest = std::max(glm::length(t.b - t.a), std::max(glm::length(t.c - t.b), glm::length(t.a - t.c)));
+	int subdivision = spacing > 0.0f ? int(std::ceil(longest / spacing)) : 1;
+	subdivision = std::max(1, std::min(subdivision, MAX_SUBDIVISION));
+
+	for (int u = 0; u <= subdivision; u++)
+	{
+		for (int v = 0; u + v <= subdivision; v++)
+		{
+			int w = subdivision - u - v;
+			if (!corners && (u == subdivision || v == subdivision || w == subdivision)) continue;
+
+			float d = signedDistance((float(u) * t.a + float(v) * t.b + float(w) * t.c) / float(subdivision));
+			range.min = std::min(range.min, d);
+			range.max = std::max(range.max, d);
+		}
+	}
+}
+
+// The cells are cubes, sized for about one triangle per cell over the bounding box, but no smaller than
+// 1/MAX_GRID_SIZE of its largest extent. Triangles are binned in every cell their bounding box overlaps
+void SurfaceDistance::buildGrid()
+{
+	glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+	for (const Triangle& t : triangles)
+	{
+		if (!t.finite) continue;
+		boundsMin = glm::min(boundsMin, glm::min(t.a, glm::min(t.b, t.c)));
+		boundsMax = glm::max(boundsMax, glm::max(t.a, glm::max(t.b, t.c)));
+	}
+
+	if (!(boundsMin.x <= boundsMax.x)) return; // Nothing to measure against
+
+	glm::vec3 extent = boundsMax - boundsMin;
+	diagonal = glm::length(extent);
+	float largest = std::max(extent.x, std::max(extent.y, extent.z));
+	if (largest <= 0.0f) largest = 1.0f;
+
+	glm::vec3 clamped = glm::max(extent, glm::vec3(largest / MAX_GRID_SIZE));
+	cellSize = std::max(std::cbrt(clamped.x * clamped.y * clamped.z / float(triangles.size())), largest / MAX_GRID_SIZE);
+	gridMin = boundsMin;
+	gridSize = glm::max(glm::ivec3(glm::ceil(extent / cellSize)), glm::ivec3(1));
+	gridSize = glm::min(gridSize, glm::ivec3(MAX_GRID_SIZE));
+
+	const size_t ncells = size_t(gridSize.x) * gridSize.y * gridSize.z;
+	cellStart.assign(ncells + 1, 0);
+
+	// Count the triangles of every cell, then fill the lists
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (pass == 1) {
+			for (size_t cell = 0; cell < ncells; cell++) cellStart[cell + 1] += cellStart[cell];
+			cellTriangles.resize(cellStart[ncells]);
+		}
+
+		std::vector<GLuint> filled(pass == 1 ? ncells : 0, 0);
+		for (GLuint i = 0; i < GLuint(triangles.size()); i++)
+		{
+			const Triangle& t = triangles[i];
+			if (!t.finite) continue;
+
+			glm::ivec3 first = cellOf(glm::min(t.a, glm::min(t.b, t.c)));
+			glm::ivec3 last = cellOf(glm::max(t.a, glm::max(t.b, t.c)));
+
+			for (int z = first.z; z <= last.z; z++)
+			{
+				for (int y = first.y; y <= last.y; y++)
+				{
+					for (int x = first.x; x <= last.x; x++)
+					{
+						size_t cell = (size_t(z) * gridSize.y + y) * gridSize.x + x;
+						if (pass == 0) cellStart[cell + 1]++;
+						else cellTriangles[cellStart[cell] + filled[cell]++] = i;
+					}
+				}
+			}
+		}
+	}
+}
+
+glm::ivec3 SurfaceDistance::cellOf(const glm::vec3& p) const
+{
+	glm::vec3 cell = glm::floor((p - gridMin) / cellSize);
+	cell = glm::clamp(cell, glm::vec3(0.0f), glm::vec3(gridSize - 1));
+	return glm::ivec3(cell);
+}
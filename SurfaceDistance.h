@@ -0,0 +1,84 @@
+/*
+ *	Distances between triangle surfaces, used to measure how far a simplified mesh actually is from the
+ *	mesh it was made from, instead of trusting the quadric error bound of the simplification. The triangles
+ *	are binned in a uniform grid, and the closest triangle to a point is found by searching the grid cells
+ *	in growing rings around it. Distances are signed by the normal of the closest triangle, so they are
+ *	positive outside a closed surface whose triangles face outwards.
+ */
+
+#ifndef SURFACEDISTANCE_H
+#define SURFACEDISTANCE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct Vertex;
+class HalfEdgeMesh;
+
+class SurfaceDistance {
+public:
+	// Range of signed distances
+	struct Range {
+		float min = 0.0f;
+		float max = 0.0f;
+
+		float largest() const { return glm::max(-min, max); }
+	};
+
+	SurfaceDistance() = default;
+
+	// Bin the triangles of a surface
+	explicit SurfaceDistance(const HalfEdgeMesh& mesh);
+	SurfaceDistance(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+	// Signed distance from a point to the surface
+	float signedDistance(const glm::vec3& p) const;
+
+	// Signed distances to this surface from points of another surface: its vertices, and points spread over its
+	// triangles at most 1/128 of its bounding box diagonal apart. The points are split over the given number of threads
+	Range distancesFrom(const SurfaceDistance& other, unsigned threads = 0) const;
+
+	// Signed distances to this surface from each triangle of another surface, sampled as in distancesFrom but
+	// including the corners. Triangles with corners that are not finite get the range (0, 0)
+	void triangleDistancesFrom(const SurfaceDistance& other, std::vector<Range>& ranges, unsigned threads = 0) const;
+
+	// Largest distance from a point on either surface to the other one, as sampled by distancesFrom
+	static float hausdorff(const SurfaceDistance& a, const SurfaceDistance& b, unsigned threads = 0);
+
+	// Length of the diagonal of the bounding box of the triangles
+	float boundsDiagonal() const { return diagonal; }
+
+	// True if there are no finite triangles to measure against
+	bool empty() const { return cellTriangles.empty(); }
+
+private:
+	struct Triangle {
+		glm::vec3 a, b, c;
+		glm::vec3 normal;	// unit face normal, or zero for a degenerate triangle
+		bool finite;		// false if a corner is not finite, which leaves the triangle out
+	};
+
+	std::vector<glm::vec3> positions;	// unique vertices, sampled by distancesFrom
+	std::vector<Triangle> triangles;
+	float diagonal = 0.0f;				// of the bounding box of the triangles
+
+	// Grid of triangle lists, with the triangles of cell i at cellTriangles[cellStart[i], cellStart[i + 1])
+	glm::vec3 gridMin = glm::vec3(0.0f);
+	float cellSize = 1.0f;
+	glm::ivec3 gridSize = glm::ivec3(0);
+	std::vector<GLuint> cellStart;
+	std::vector<GLuint> cellTriangles;
+
+	void addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+	// Widen a range by the signed distances of points spread over a triangle
+	void sampleTriangle(const Triangle& t, float spacing, bool corners, Range& range) const;
+
+	// Bin the triangles, after all have been added
+	void buildGrid();
+
+	glm::ivec3 cellOf(const glm::vec3& p) const;
+};
+#endif
@@ -0,0 +1,226 @@
+/*
+ *	Compile-time description of the vertex buffers of a mesh. A layout lists the attributes
+ *	of one interleaved vertex, e.g. Layout<Position3f, NormalOct16, TexCoord16>, and generates
+ *	the stride, the attribute offsets, the glVertexAttribPointer calls and the encoding of
+ *	Vertex data into that format. Nothing about the layout is looked up at runtime.
+ */
+
+#ifndef VERTEXLAYOUT_H
+#define VERTEXLAYOUT_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "Mesh.h"
+
+#include <cmath>
+#include <cstring>
+
+// Flags telling the shaders how to decode the attributes of a layout
+const unsigned QUANTIZED_POSITIONS = 1;	// positions are relative to the bounds
+const unsigned OCTAHEDRAL_NORMALS = 2;	// normals are octahedral encoded in 2 components
+
+// Mapping from the bounds of a mesh to the [-1, 1] range of quantized positions
+struct VertexEncoding {
+	glm::vec3 center = ZERO;
+	glm::vec3 halfExtent = glm::vec3(1.0f);
+
+	VertexEncoding() = default;
+	explicit VertexEncoding(const Bounds& bounds)
+		: center(0.5f * (bounds.min + bounds.max)),
+		  // Flat meshes have no extent along some axis, any scale decodes them
+		  halfExtent(glm::max(0.5f * (bounds.max - bounds.min), glm::vec3(1e-20f))) {}
+};
+
+// Octahedral encoding of a unit vector: the vector is projected on the octahedron |x|+|y|+|z| = 1,
+// and the lower half is folded over the upper half so that it maps to the [-1, 1] square
+inline glm::vec2 encodeOctahedral(glm::vec3 n)
+{
+	float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (sum == 0.0f) return glm::vec2(0.0f);
+
+	glm::vec2 p = glm::vec2(n) / sum;
+	if (n.z < 0.0f) {
+		p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return p;
+}
+
+// Storage of the packed attributes. Every attribute is a multiple of 4 bytes, so all offsets stay aligned
+struct Short4 { GLshort v[4]; };
+struct Short2 { GLshort v[2]; };
+struct Half2 { GLushort v[2]; };
+
+// Attributes. Each one describes its storage type, its location and format for glVertexAttribPointer,
+// and how it is encoded from a Vertex
+
+// float position
+struct Position3f {
+	typedef glm::vec3 Type;
+	static const GLuint location = 0;
+	static const GLint components = 3;
+	static const GLenum type = GL_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	static const unsigned flags = 0;
+
+	static void encode(const Vertex& v, const VertexEncoding&, Type& out) { out = v.Position; }
+};
+
+// 16-bit normalized position relative to the bounds, padded to 8 bytes
+struct Position16 {
+	typedef Short4 Type;
+	static const GLuint location = 0;
+	static const GLint components = 3;
+	static const GLenum type = GL_SHORT;
+	static const GLboolean normalized = GL_TRUE;
+	static const unsigned flags = QUANTIZED_POSITIONS;
+
+	static void encode(const Vertex& v, const VertexEncoding& encoding, Type& out)
+	{
+		glm::vec3 p = (v.Position - encoding.center) / encoding.halfExtent;
+		for (int k = 0; k < 3; k++)
+		{
+			out.v[k] = GLshort(glm::packSnorm1x16(p[k]));
+		}
+		out.v[3] = 0;
+	}
+};
+
+// float normal
+struct Normal3f {
+	typedef glm::vec3 Type;
+	static const GLuint location = 1;
+	static const GLint components = 3;
+	static const GLenum type = GL_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	static const unsigned flags = 0;
+
+	static void encode(const Vertex& v, const VertexEncoding&, Type& out) { out = v.Normal; }
+};
+
+// octahedral encoded normal in two 16-bit normalized components
+struct NormalOct16 {
+	typedef Short2 Type;
+	static const GLuint location = 1;
+	static const GLint components = 2;
+	static const GLenum type = GL_SHORT;
+	static const GLboolean normalized = GL_TRUE;
+	static const unsigned flags = OCTAHEDRAL_NORMALS;
+
+	static void encode(const Vertex& v, const VertexEncoding&, Type& out)
+	{
+		glm::vec2 n = encodeOctahedral(v.Normal);
+		out.v[0] = GLshort(glm::packSnorm1x16(n.x));
+		out.v[1] = GLshort(glm::packSnorm1x16(n.y));
+	}
+};
+
+// float texture coordinates
+struct TexCoord2f {
+	typedef glm::vec2 Type;
+	static const GLuint location = 2;
+	static const GLint components = 2;
+	static const GLenum type = GL_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	static const unsigned flags = 0;
+
+	static void encode(const Vertex& v, const VertexEncoding&, Type& out) { out = v.TexCoords; }
+};
+
+// half float texture coordinates
+struct TexCoord16 {
+	typedef Half2 Type;
+	static const GLuint location = 2;
+	static const GLint components = 2;
+	static const GLenum type = GL_HALF_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	static const unsigned flags = 0;
+
+	static void encode(const Vertex& v, const VertexEncoding&, Type& out)
+	{
+		out.v[0] = glm::packHalf1x16(v.TexCoords.x);
+		out.v[1] = glm::packHalf1x16(v.TexCoords.y);
+	}
+};
+
+// Recursion over the attributes of a layout, each placed at the given byte offset
+template <size_t Offset, typename... Attributes>
+struct LayoutAttributes {
+	static const size_t size = 0;
+	static const unsigned flags = 0;
+
+	static void setup(GLsizei) {}
+	static void encode(const Vertex&, const VertexEncoding&, unsigned char*) {}
+};
+
+template <size_t Offset, typename Attribute, typename... Rest>
+struct LayoutAttributes<Offset, Attribute, Rest...> {
+	typedef typename Attribute::Type Type;
+	typedef LayoutAttributes<Offset + sizeof(Type), Rest...> Next;
+
+	static_assert(sizeof(Type) % 4 == 0, "vertex attributes must be a multiple of 4 bytes");
+
+	static const size_t size = sizeof(Type) + Next::size;
+	static const unsigned flags = Attribute::flags | Next::flags;
+
+	static void setup(GLsizei stride)
+	{
+		glEnableVertexAttribArray(Attribute::location);
+		glVertexAttribPointer(Attribute::location, Attribute::components, Attribute::type, Attribute::normalized,
+			stride, (void*)Offset);
+		Next::setup(stride);
+	}
+
+	static void encode(const Vertex& v, const VertexEncoding& encoding, unsigned char* out)
+	{
+		Type value;
+		Attribute::encode(v, encoding, value);
+		std::memcpy(out + Offset, &value, sizeof(Type));
+		Next::encode(v, encoding, out);
+	}
+};
+
+// Interleaved vertex with the given attributes, in order
+template <typename... Attributes>
+struct Layout {
+	typedef LayoutAttributes<0, Attributes...> Attribs;
+
+	static const size_t stride = Attribs::size;
+	static const unsigned flags = Attribs::flags;
+
+	// set the attribute pointers of the buffer bound to GL_ARRAY_BUFFER in the bound VAO
+	static void setupAttributes() { Attribs::setup(GLsizei(stride)); }
+
+	// encode count vertices into stride * count bytes
+	static void encode(const Vertex* vertices, size_t count, const VertexEncoding& encoding, unsigned char* out)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			Attribs::encode(vertices[i], encoding, out + i * stride);
+		}
+	}
+
+	// decode scale (w is 1 for octahedral normals) and offset passed to the shaders
+	static glm::vec4 decodeScale(const VertexEncoding& encoding)
+	{
+		glm::vec3 scale = (flags & QUANTIZED_POSITIONS) ? encoding.halfExtent : glm::vec3(1.0f);
+		return glm::vec4(scale, (flags & OCTAHEDRAL_NORMALS) ? 1.0f : 0.0f);
+	}
+
+	static glm::vec3 decodeOffset(const VertexEncoding& encoding)
+	{
+		return (flags & QUANTIZED_POSITIONS) ? encoding.center : ZERO;
+	}
+};
+
+// The layouts of each vertex format: the full stream and the position-only stream
+typedef Layout<Position3f, Normal3f, TexCoord2f> FloatLayout;
+typedef Layout<Position3f> FloatPositionLayout;
+typedef Layout<Position16, NormalOct16, TexCoord16> CompactLayout;
+typedef Layout<Position16> CompactPositionLayout;
+
+static_assert(FloatLayout::stride == sizeof(Vertex), "the float layout matches the Vertex struct");
+static_assert(CompactLayout::stride == 16, "compact vertices are 16 bytes");
+
+#endif
@@ -11,14 +11,25 @@
 #include "Camera.h"
 #include "Mesh.h"
 #include "MeshCreator.h"
+#include "LodChain.h"
+#include "ShadowVolume.h"
+#include "LightBounds.h"
+#include "SilhouetteExtractor.h"
+#include "ShadowVolumeBuffer.h"
 
 #include <iostream>
 
 void init();
+void cleanup();
 void display(GLFWwindow* window);
-void drawShadowVolumes();
+void drawShadowVolumes(bool setStencil);
+bool setupShadowVolume(const Mesh& caster, const glm::mat4& model, ShadowCaster& volume);
+void setShadowVolumeStencil(bool zFail);
+void drawShadowVolume(Mesh& caster, const ShadowCaster& volume);
+void drawCpuShadowVolumes(const std::vector<ShadowCaster>& volumes, bool setStencil);
+void useShadowVolumeShader(Shader& shader, const glm::mat4& model, float extrusionDistance);
 void drawLightSources();
-void drawScene(Shader & objShader);
+void drawScene(Shader & objShader, VertexStream stream);
 void createWindow(const unsigned int height, const unsigned int width, const char* name);
 void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -31,7 +42,35 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
+// Distance within which vertices of loaded meshes are welded together
+const float WELD_EPSILON = 1e-5f;
+
+// Vertex format of the rendered meshes. VertexFormat::Compact uploads 16-bit positions, octahedral normals
+// and half float texture coordinates
+const VertexFormat VERTEX_FORMAT = VertexFormat::Float;
+
+// Quadric error bound, in model units, of the simplification of an occluder into the proxy that casts its
+// shadow. This is a root mean square distance to the planes of the removed triangles, not a distance bound:
+// the proxy is shrunk to fit inside the occluder afterwards, and its measured Hausdorff distance is printed
+const float SHADOW_PROXY_ERROR = 0.005f;
+
+// Quadric error bound of the first simplified level of detail, in model units, and the largest measured
+// distance from the full mesh, in pixels, that a selected level may project to
+const float LOD_BASE_ERROR = 0.002f;
+const float LOD_PIXEL_ERROR = 1.0f;
+
+// Distance at which the light fades out. Nothing beyond it is lit or shadowed
+const float LIGHT_RANGE = 6.0f;
+
 bool showShadowVolume = false;
+bool useEdgeList = true; // Extrude shadow volumes from the edge list instead of triangles with adjacency
+bool useShadowProxies = true; // Extrude shadow volumes from the simplified proxies instead of the occluders
+bool useLods = true; // Render the objects at the level of detail selected by their projected error
+bool autoZPass = true; // Render the shadow volumes that can not reach the camera with z-pass instead of z-fail
+bool cullShadowVolumes = true; // Skip the shadow volumes that can not reach the view frustum
+bool useLightBounds = true; // Limit the volume and lit passes to the screen region within the range of the light
+bool finiteVolumes = true; // End the shadow volumes beyond the range of the light instead of at infinity
+bool useCpuVolumes = false; // Generate the shadow volumes on the CPU instead of in geometry shaders
 
 GLFWwindow* window = nullptr;
 
@@ -49,9 +88,15 @@ float lastFrame = 0.0f;
 
 // shaders
 Shader ambientShader, objShader, lampShader, geomShader, shadowVolumeShader;
+Shader shadowVolumeSidesShader, shadowVolumeEdgeShader, shadowVolumeCapShader, shadowVolumeBackCapShader;
+Shader shadowVolumeCpuShader;
 
 // objects
 Mesh object, object2, lamp;
+Mesh objectProxy, object2Proxy; // Simplified occluders for the shadow volume passes
+LodChain objectLods, object2Lods; // Levels of detail of the objects, rendered by drawScene
+SilhouetteExtractor silhouettes; // Shadow volumes generated on the CPU
+ShadowVolumeBuffer volumeBuffer; // and streamed to the GPU
 Mesh ground, rightWall, leftWall, backWall;
 
 // lighting
@@ -94,6 +139,10 @@ int main()
 		return -1;
 	}
 
+	// Optional: limits the light passes to the pixels whose depth is within the range of the light
+	if (!LightBounds::loadDepthBoundsTest((GLADloadproc)glfwGetProcAddress))
+		std::cout << "EXT_depth_bounds_test not supported, using the scissor test only" << std::endl;
+
 	// Initialization 
 	// --------------
 	init();
@@ -129,6 +178,10 @@ int main()
 		glfwPollEvents();
 	}
 
+	// Delete GL objects while the context is still current
+	// ----------------------------------------------------
+	cleanup();
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -149,19 +202,46 @@ void init()
 
 	// Create geometry for rendering
 	// -----------------------------
-	//object = MeshCreator::createBox(0.3f, 0.3f, 0.2f);
-	object = MeshCreator::readOBJ("meshes/torus_thingy.obj");
-	object2 = MeshCreator::createBox(0.3f, 01.0f, 0.2f);
-	lamp = MeshCreator::createSphere(0.1f, 10);
-
-	ground = MeshCreator::createBox(WALLSIZE, 0.01f, WALLSIZE);
-	rightWall = MeshCreator::createBox(0.01f, WALLSIZE, WALLSIZE);
-	leftWall = MeshCreator::createBox(0.01f, WALLSIZE, WALLSIZE);
-	backWall = MeshCreator::createBox(WALLSIZE, WALLSIZE, 0.01f);
+	//object = MeshCreator::createBox(0.3f, 0.3f, 0.2f, Residency::KeepAll, VERTEX_FORMAT);
+	object = MeshCreator::readOBJ("meshes/torus_thingy.obj", WELD_EPSILON, Residency::KeepAll, VERTEX_FORMAT);
+	object2 = MeshCreator::createBox(0.3f, 01.0f, 0.2f, Residency::KeepAll, VERTEX_FORMAT);
+	// The lamp is only drawn with positions
+	lamp = MeshCreator::createSphere(0.1f, 10, Residency::ReleaseAll, VertexFormat::PositionOnly);
+
+	// Meshes that are only rendered are generated in the staging arena and keep nothing on the CPU
+	ground = MeshCreator::createBox(WALLSIZE, 0.01f, WALLSIZE, Residency::ReleaseAll, VERTEX_FORMAT);
+	rightWall = MeshCreator::createBox(0.01f, WALLSIZE, WALLSIZE, Residency::ReleaseAll, VERTEX_FORMAT);
+	leftWall = MeshCreator::createBox(0.01f, WALLSIZE, WALLSIZE, Residency::ReleaseAll, VERTEX_FORMAT);
+	backWall = MeshCreator::createBox(WALLSIZE, WALLSIZE, 0.01f, Residency::ReleaseAll, VERTEX_FORMAT);
+	MeshCreator::staging().release();
 
 	// Generate adjacency information for occluders
 	object.useAdjacency();
 	object2.useAdjacency();
+	object.reportAdjacency("object");
+	object2.reportAdjacency("object2");
+
+	// Generate edge lists, where each unique edge is only extruded once
+	object.useEdgeList();
+	object2.useEdgeList();
+
+	// Simplified occluders, so the volumes only extrude the silhouette detail that shows in the shadows
+	objectProxy = MeshCreator::createShadowProxy(object, SHADOW_PROXY_ERROR);
+	object2Proxy = MeshCreator::createShadowProxy(object2, SHADOW_PROXY_ERROR);
+
+	// Levels of detail of the objects, so their vertex cost follows their size on screen
+	objectLods.build(object, LOD_BASE_ERROR);
+	object2Lods.build(object2, LOD_BASE_ERROR);
+
+	// Drop the CPU-side copies that are no longer needed. The main occluder keeps everything
+	// so its adjacency generation can be benchmarked, the other occluder keeps its connectivity
+	// for CPU-side queries, like the proxies. Everything else was created without CPU-side copies
+	object2.setResidency(Residency::KeepConnectivity);
+
+	object.reportMemory("object");
+	object2.reportMemory("object2");
+	lamp.reportMemory("lamp");
+	objectProxy.reportMemory("objectProxy");
 
 	// Create static transformation matrices
 	// -------------------------------------
@@ -175,6 +255,40 @@ void init()
 	lampShader.create("shaders/lamp.vert", "shaders/lamp.frag");
 	geomShader.create("shaders/geomShader.vert", "shaders/geomShader.frag", "shaders/geomShader.geom");
 	shadowVolumeShader.create("shaders/shadowVolume.vert", "shaders/shadowVolume.frag", "shaders/shadowVolume.geom");
+	shadowVolumeSidesShader.create("shaders/shadowVolume.vert", "shaders/shadowVolume.frag", "shaders/shadowVolume.geom", "#define NO_CAPS\n");
+	shadowVolumeEdgeShader.create("shaders/shadowVolume.vert", "shaders/shadowVolume.frag", "shaders/shadowVolumeEdges.geom");
+	shadowVolumeCapShader.create("shaders/shadowVolume.vert", "shaders/shadowVolume.frag", "shaders/shadowVolumeCaps.geom");
+	shadowVolumeBackCapShader.create("shaders/shadowVolume.vert", "shaders/shadowVolume.frag", "shaders/shadowVolumeCaps.geom", "#define BACK_CAP_ONLY\n");
+	shadowVolumeCpuShader.create("shaders/shadowVolumeCpu.vert", "shaders/shadowVolume.frag");
+}
+
+// Release the meshes and shaders. Their GL objects are deleted by their handles
+//--------------------------------------------------------------------------
+void cleanup()
+{
+	objectLods = LodChain();
+	object2Lods = LodChain();
+	object = Mesh();
+	object2 = Mesh();
+	objectProxy = Mesh();
+	object2Proxy = Mesh();
+	lamp = Mesh();
+	ground = Mesh();
+	rightWall = Mesh();
+	leftWall = Mesh();
+	backWall = Mesh();
+
+	ambientShader = Shader();
+	objShader = Shader();
+	lampShader = Shader();
+	geomShader = Shader();
+	shadowVolumeShader = Shader();
+	shadowVolumeSidesShader = Shader();
+	shadowVolumeEdgeShader = Shader();
+	shadowVolumeCapShader = Shader();
+	shadowVolumeBackCapShader = Shader();
+	shadowVolumeCpuShader = Shader();
+	volumeBuffer = ShadowVolumeBuffer();
 }
 
 // Display function - draws and renders!
@@ -195,11 +309,20 @@ void display(GLFWwindow* window)
 
 	lampMat = glm::translate(glm::mat4(), lightPos);
 
+	// select the levels of detail once, so both scene passes draw the same triangles
+	objectLods.select(objMat, view, projection, float(SCR_HEIGHT), useLods ? LOD_PIXEL_ERROR : 0.0f);
+	object2Lods.select(obj2Mat, view, projection, float(SCR_HEIGHT), useLods ? LOD_PIXEL_ERROR : 0.0f);
+
 	// Ambient pass: To make sure z-buffer contains data
 	// ----------------------------------------
-	drawScene(ambientShader);
+	drawScene(ambientShader, VertexStream::PositionOnly);
 	drawLightSources();
 
+	// Limit the light passes to the screen region the light can reach. If none of it is visible,
+	// the ambient pass is the final image
+	if (useLightBounds && !LightBounds::enable(lightPos, LIGHT_RANGE, view, projection))
+		return;
+
 	// Create shadow volumes of objects and render into the stencil buffer 
 	// ------------------------------------------------------------------
 	glEnable(GL_STENCIL_TEST);
@@ -217,10 +340,8 @@ void display(GLFWwindow* window)
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 	glDepthMask(GL_FALSE);
 
-	// set stencil test according to zfail algorithm
-	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
-	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
-	drawShadowVolumes();
+	// set stencil test according to the zpass or zfail algorithm, chosen per occluder
+	drawShadowVolumes(true);
 
 	// disable depth clamping
 	glDisable(GL_DEPTH_CLAMP);
@@ -240,7 +361,7 @@ void display(GLFWwindow* window)
 	// prevent update to the stencil buffer
 	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 
-	drawScene(objShader);
+	drawScene(objShader, VertexStream::Full);
 	drawLightSources();
 
 	// Clean up: Reset some things needed for the ambient pass next frame
@@ -249,22 +370,138 @@ void display(GLFWwindow* window)
 	glDepthFunc(GL_LEQUAL);
 
 	glDisable(GL_STENCIL_TEST);
+	LightBounds::disable();
 }
 
 // render the shadow volumes of the occluders in the scene
+// Volumes that can not reach the view frustum or whose occluder is out of the range of the light are
+// skipped. Each volume is rendered with z-pass and without front cap, unless the near plane of the camera
+// may be in its shadow. The volumes are generated by geometry shaders or on the CPU. setStencil selects
+// the stencil operations of the algorithm, which is not wanted when the volumes are only shown
+// -------------------------------------------------------
+void drawShadowVolumes(bool setStencil)
+{
+	Mesh* casters[2] = { useShadowProxies ? &objectProxy : &object, useShadowProxies ? &object2Proxy : &object2 };
+	const glm::mat4 models[2] = { objMat, obj2Mat };
+
+	std::vector<ShadowCaster> volumes;
+	std::vector<Mesh*> visible;
+	for (int i = 0; i < 2; i++)
+	{
+		ShadowCaster volume;
+		if (!setupShadowVolume(*casters[i], models[i], volume)) continue;
+		volumes.push_back(volume);
+		visible.push_back(casters[i]);
+	}
+
+	if (useCpuVolumes) {
+		drawCpuShadowVolumes(volumes, setStencil);
+		return;
+	}
+
+	for (size_t i = 0; i < volumes.size(); i++)
+	{
+		if (setStencil) setShadowVolumeStencil(volumes[i].caps);
+		drawShadowVolume(*visible[i], volumes[i]);
+	}
+}
+
+// decide how the shadow volume of one occluder is rendered: with z-fail and caps if the near plane may
+// be inside it and otherwise with z-pass, and extruded to infinity or, for finite volumes, to just beyond
+// the range of the light. Returns false if the volume is culled
+// -------------------------------------------------------
+bool setupShadowVolume(const Mesh& caster, const glm::mat4& model, ShadowCaster& volume)
+{
+	if (cullShadowVolumes && !ShadowVolume::mayBeVisible(caster.getBounds(), model, lightPos, projection * view))
+		return false;
+
+	volume.mesh = &caster.getHalfEdgeMesh();
+	volume.model = model;
+	volume.extrusionDistance = 0.0f;
+	if (finiteVolumes) {
+		if (!ShadowVolume::isInRange(caster.getBounds(), model, lightPos, LIGHT_RANGE))
+			return false;
+		volume.extrusionDistance = ShadowVolume::extrusionDistance(caster.getBounds(), model, lightPos, LIGHT_RANGE);
+	}
+
+	volume.caps = !autoZPass || ShadowVolume::needsZFail(caster.getBounds(), model, lightPos, projection * view);
+	return true;
+}
+
+// set the stencil operations of the zfail or the zpass algorithm
+// -------------------------------------------------------
+void setShadowVolumeStencil(bool zFail)
+{
+	if (zFail) {
+		// count the volume faces behind the scene
+		glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+		glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+	} else {
+		// count the volume faces in front of the scene
+		glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+		glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+	}
+}
+
+// render the shadow volume of one occluder with the geometry shaders. The sides are extruded from the edge
+// list or from the triangles with adjacency. A finite volume needs its back cap with z-pass too, since the
+// scene behind its end must not be counted as inside it
+// -------------------------------------------------------
+void drawShadowVolume(Mesh& caster, const ShadowCaster& volume)
+{
+	const glm::mat4& model = volume.model;
+	float extrusionDistance = volume.extrusionDistance;
+	bool zFail = volume.caps;
+
+	if (!useEdgeList) {
+		Shader& shader = zFail ? shadowVolumeShader : shadowVolumeSidesShader;
+		useShadowVolumeShader(shader, model, extrusionDistance);
+		caster.render(DrawMode::Adjacency, VertexStream::PositionOnly);
+		return;
+	}
+
+	// sides from the silhouette edges
+	useShadowVolumeShader(shadowVolumeEdgeShader, model, extrusionDistance);
+	caster.render(DrawMode::Edges, VertexStream::PositionOnly);
+
+	// front and back caps, or only the back cap of a finite volume
+	if (zFail) {
+		useShadowVolumeShader(shadowVolumeCapShader, model, extrusionDistance);
+		caster.render(DrawMode::Triangles, VertexStream::PositionOnly);
+	} else if (extrusionDistance > 0.0f) {
+		useShadowVolumeShader(shadowVolumeBackCapShader, model, extrusionDistance);
+		caster.render(DrawMode::Triangles, VertexStream::PositionOnly);
+	}
+}
+
+// generate the shadow volumes of the occluders on the CPU, in parallel, stream them to the GPU and render
+// them as plain triangles. The occluders need their half-edge meshes
 // -------------------------------------------------------
-void drawShadowVolumes()
+void drawCpuShadowVolumes(const std::vector<ShadowCaster>& volumes, bool setStencil)
 {
-	shadowVolumeShader.use();
-	shadowVolumeShader.setMat4("projection", projection);
-	shadowVolumeShader.setMat4("view", view);
-	shadowVolumeShader.setVec3("lightPos", lightPos);
+	silhouettes.extract(volumes, lightPos);
+	volumeBuffer.upload(silhouettes);
 
-	shadowVolumeShader.setMat4("model", objMat);
-	object.render();
+	shadowVolumeCpuShader.use();
+	shadowVolumeCpuShader.setMat4("projection", projection);
+	shadowVolumeCpuShader.setMat4("view", view);
+	for (size_t i = 0; i < volumes.size(); i++)
+	{
+		if (setStencil) setShadowVolumeStencil(volumes[i].caps);
+		volumeBuffer.draw(silhouettes, i);
+	}
+}
 
-	shadowVolumeShader.setMat4("model", obj2Mat);
-	object2.render();
+// activate a shadow volume shader and set its uniforms. An extrusion distance of 0 extrudes to infinity
+// -------------------------------------------------------
+void useShadowVolumeShader(Shader& shader, const glm::mat4& model, float extrusionDistance)
+{
+	shader.use();
+	shader.setMat4("projection", projection);
+	shader.setMat4("view", view);
+	shader.setVec3("lightPos", lightPos);
+	shader.setFloat("extrusionDistance", extrusionDistance);
+	shader.setMat4("model", model);
 }
 
 // render geometry for the light sources in the scene
@@ -276,45 +513,46 @@ void drawLightSources()
 	lampShader.setMat4("view", view);
 	lampShader.setVec3("lightColor", lightColor);
 	lampShader.setMat4("model", lampMat);
-	lamp.render();
+	lamp.render(DrawMode::Triangles, VertexStream::PositionOnly);
 }
 
-// render the scene using the passed shader
-// -----------------------------------------
-void drawScene(Shader & objShader)
+// render the scene using the passed shader and vertex stream
+// -----------------------------------------------------------
+void drawScene(Shader & objShader, VertexStream stream)
 {
 	objShader.use();
 	objShader.setVec3("lightColor", lightColor);
 	objShader.setVec3("lightPos", lightPos);
+	objShader.setFloat("lightRange", LIGHT_RANGE);
 	objShader.setMat4("projection", projection);
 	objShader.setMat4("view", view);
 
 	// ground and walls
 	objShader.setVec3("objectColor", groundColor);
 	objShader.setMat4("model", glm::translate(glm::mat4(), glm::vec3(0.0f, -1.0f, 0.0f)));
-	ground.render();
+	ground.render(DrawMode::Triangles, stream);
 
 	objShader.setMat4("model", glm::translate(glm::mat4(), glm::vec3(WALLSIZE, WALLSIZE - 1.0f, 0.0f)));
-	rightWall.render();
+	rightWall.render(DrawMode::Triangles, stream);
 
 	objShader.setMat4("model", glm::translate(glm::mat4(), glm::vec3(-WALLSIZE, WALLSIZE - 1.0f, 0.0f)));
-	leftWall.render();
+	leftWall.render(DrawMode::Triangles, stream);
 
 	objShader.setMat4("model", glm::translate(glm::mat4(), glm::vec3(0.0f, WALLSIZE - 1.0f,- WALLSIZE)));
-	backWall.render();
+	backWall.render(DrawMode::Triangles, stream);
 
 	// objects
 	objShader.setMat4("model", objMat);
 	objShader.setVec3("objectColor", orange);
-	object.render();
+	objectLods.current().render(DrawMode::Triangles, stream);
 
 	objShader.setMat4("model", obj2Mat);
 	objShader.setVec3("objectColor", green);
-	object2.render();
+	object2Lods.current().render(DrawMode::Triangles, stream);
 
 	if (showShadowVolume) {
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		drawShadowVolumes();
+		drawShadowVolumes(false);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	}
 }
@@ -372,6 +610,47 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	// Show shadow volumes
 	if (key == GLFW_KEY_V && action == GLFW_PRESS)
 		showShadowVolume = !showShadowVolume;
+
+	// Switch between extruding shadow volumes from edge lists and from triangles with adjacency
+	if (key == GLFW_KEY_E && action == GLFW_PRESS)
+		useEdgeList = !useEdgeList;
+
+	// Switch between extruding shadow volumes from the simplified proxies and from the full occluders
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		useShadowProxies = !useShadowProxies;
+
+	// Switch between choosing z-pass or z-fail per occluder and always using z-fail
+	if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+		autoZPass = !autoZPass;
+
+	// Switch culling the shadow volumes outside of the view frustum
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+		cullShadowVolumes = !cullShadowVolumes;
+
+	// Switch limiting the light passes to the range of the light
+	if (key == GLFW_KEY_R && action == GLFW_PRESS)
+		useLightBounds = !useLightBounds;
+
+	// Switch between shadow volumes ending beyond the range of the light and infinite ones
+	if (key == GLFW_KEY_F && action == GLFW_PRESS)
+		finiteVolumes = !finiteVolumes;
+
+	// Switch between generating the shadow volumes on the CPU and in geometry shaders
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+		useCpuVolumes = !useCpuVolumes;
+
+	// Print the time of the last CPU shadow volume generation
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+		std::cout << "CPU shadow volumes: " << silhouettes.totalVertices() << " vertices, extracted in "
+			<< silhouettes.extractMilliseconds() << " ms, written in " << silhouettes.writeMilliseconds() << " ms" << std::endl;
+
+	// Switch between the selected levels of detail and the full meshes
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+		useLods = !useLods;
+
+	// Benchmark the adjacency generation of the main occluder
+	if (key == GLFW_KEY_B && action == GLFW_PRESS)
+		object.reportAdjacencyScaling();
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
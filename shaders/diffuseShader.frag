@@ -5,6 +5,7 @@ in vec3 pos;
 
 uniform mat4 model;
 uniform vec3 lightPos;
+uniform float lightRange; // distance at which the light fades out
 uniform vec3 lightColor;
 uniform vec3 objectColor;
 
@@ -18,13 +19,18 @@ void main()
 	// direction from light to surface
 	vec3 lightDir = normalize(lightPos - fragPos);
 
+	// smooth falloff that reaches zero at the range of the light, so nothing beyond it is lit
+	float d = length(lightPos - fragPos) / lightRange;
+	float falloff = clamp(1.0 - d * d, 0.0, 1.0);
+	float attenuation = falloff * falloff;
+
 	// compute ambient contribution
 	float ambientStrength = 0.1;
     vec3 ambient = ambientStrength * lightColor;
 
 	// compute diffuse contribution
 	float diff = max(dot(normal, lightDir), 0.0);
-	vec3 diffuse = diff * lightColor;
+	vec3 diffuse = attenuation * diff * lightColor;
 
 	vec3 shading = (ambient + diffuse) * objectColor; 
     finalColor = vec4(shading, 1.0);
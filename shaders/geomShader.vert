@@ -1,6 +1,8 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+layout (location = 3) in vec4 aDecodeScale;  // constant per mesh: position scale, and 1 in w if normals are octahedral
+layout (location = 4) in vec3 aDecodeOffset; // constant per mesh: position offset
 
 // Thing to pass to geometry shader
 out VS_OUT {
@@ -11,9 +13,20 @@ uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
+// Normals of compact meshes are octahedral encoded in xy
+vec3 decodeNormal(vec3 n)
+{
+    if (aDecodeScale.w == 0.0) return n;
+
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0); 
+    vec3 position = aDecodeOffset + aDecodeScale.xyz * aPos;
+    gl_Position = projection * view * model * vec4(position, 1.0); 
     mat3 normalMatrix = mat3(transpose(inverse(view * model)));
-    vs_out.normal = normalize(vec3(projection * vec4(normalMatrix * aNormal, 0.0)));
+    vs_out.normal = normalize(vec3(projection * vec4(normalMatrix * decodeNormal(aNormal), 0.0)));
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 3) in vec4 aDecodeScale;  // constant per mesh: position scale, and 1 in w if normals are octahedral
+layout (location = 4) in vec3 aDecodeOffset; // constant per mesh: position offset
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -7,5 +9,6 @@ uniform mat4 model;
 
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0); 
+    vec3 position = aDecodeOffset + aDecodeScale.xyz * aPos;
+    gl_Position = model * vec4(position, 1.0); 
 }
\ No newline at end of file
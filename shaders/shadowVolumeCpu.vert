@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec4 aPos; // world space, w is 0 for vertices extruded to infinity
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    gl_Position = projection * view * aPos;
+}
@@ -0,0 +1,182 @@
+/*
+ *	Offline mesh preprocessing tool, built separately from the GLFW application (see tools/Makefile).
+ *	Every OBJ file given on the command line is welded, deduplicated, reordered for the vertex cache,
+ *	for overdraw and for vertex fetches, and written as a binary mesh with adjacency, edge list and bounds.
+ *	The output is written next to the OBJ file as the cache that MeshCreator::readOBJ looks for,
+ *	so the application loads the optimized mesh as long as the OBJ file and weld epsilon are unchanged.
+ *
+ *	Usage: meshtool [-e epsilon] [-c cachesize] [-o output] file.obj ...
+ */
+
+#include "Mesh.h"
+#include "HalfEdgeMesh.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Same weld distance as the demo application, so it can use the written meshes as its cache
+static float weldEpsilon = 1e-5f;
+
+// Size of the FIFO cache used for the ACMR statistics and the overdraw clusters
+static GLuint cacheSize = 16;
+
+// Times the stages of processing one file
+class StageTimer {
+public:
+	StageTimer() : start(std::chrono::high_resolution_clock::now()) {}
+
+	// Print the time since the previous stage, followed by the statistics of the stage
+	void stage(const char* name, const char* format, ...)
+	{
+		auto now = std::chrono::high_resolution_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(now - start).count();
+		total += ms;
+		start = now;
+
+		printf("  %-16s %10.2f ms   ", name, ms);
+		va_list args;
+		va_start(args, format);
+		vprintf(format, args);
+		va_end(args);
+		printf("\n");
+	}
+
+	double totalTime() const { return total; }
+
+private:
+	std::chrono::high_resolution_clock::time_point start;
+	double total = 0.0;
+};
+
+// Run the whole pipeline on one OBJ file. Returns false on errors
+static bool processFile(const char* input, const char* output)
+{
+	printf("meshtool: %s -> %s\n", input, output);
+	StageTimer timer;
+
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	if (!ObjParser::parse(input, vertices, indices)) return false;
+	const GLuint ntris = GLuint(indices.size() / 3);
+	timer.stage("parse + dedup", "%u triangles, %u vertices", ntris, GLuint(vertices.size()));
+
+	GLuint moved = MeshOptimizer::weldPositions(vertices, weldEpsilon);
+	if (moved > 0) MeshOptimizer::indexVertices(vertices, indices);
+	timer.stage("weld", "%u vertices moved within %g, %u vertices", moved, weldEpsilon, GLuint(vertices.size()));
+
+	const GLuint nverts = GLuint(vertices.size());
+	HalfEdgeMesh halfEdgeMesh(vertices, indices);
+	std::vector<GLuint> adjacency, edges;
+	halfEdgeMesh.genAdjacencyIndices(adjacency);
+	halfEdgeMesh.genEdgeListIndices(edges);
+	timer.stage("adjacency", "%u unique edges, %u boundary, %u non-manifold",
+		halfEdgeMesh.numEdges(), halfEdgeMesh.numBoundaryEdges(), halfEdgeMesh.numNonManifoldEdges());
+	halfEdgeMesh.clear();
+
+	// The adjacency indices are reordered along with the triangles and vertices from here on
+	std::vector<GLuint> triangleOrder, vertexRemap;
+
+	MeshOptimizer::VertexCacheStats before = MeshOptimizer::analyzeVertexCache(indices, nverts, cacheSize);
+	MeshOptimizer::optimizeVertexCache(indices, nverts, &triangleOrder);
+	MeshOptimizer::reorderTriangles(adjacency, 6, triangleOrder);
+	MeshOptimizer::VertexCacheStats optimized = MeshOptimizer::analyzeVertexCache(indices, nverts, cacheSize);
+	timer.stage("vertex cache", "ACMR %.3f -> %.3f (FIFO %u)", before.acmr, optimized.acmr, cacheSize);
+
+	GLuint nclusters = MeshOptimizer::optimizeOverdraw(indices, vertices, &triangleOrder, cacheSize);
+	MeshOptimizer::reorderTriangles(adjacency, 6, triangleOrder);
+	MeshOptimizer::VertexCacheStats after = MeshOptimizer::analyzeVertexCache(indices, nverts, cacheSize);
+	timer.stage("overdraw", "%u clusters, ACMR %.3f -> %.3f", nclusters, optimized.acmr, after.acmr);
+
+	MeshOptimizer::optimizeVertexFetch(vertices, indices, vertexRemap);
+	MeshOptimizer::remapIndices(adjacency, vertexRemap);
+	MeshOptimizer::remapIndices(edges, vertexRemap);
+	MeshOptimizer::VertexCacheStats fetched = MeshOptimizer::analyzeVertexCache(indices, nverts, cacheSize);
+	timer.stage("vertex fetch", "ATVR %.3f -> %.3f", before.atvr, fetched.atvr);
+
+	std::vector<glm::vec3> positions(nverts);
+	for (GLuint i = 0; i < nverts; i++)
+	{
+		positions[i] = vertices[i].Position;
+	}
+	Bounds bounds = computeBounds(vertices.data(), nverts);
+	timer.stage("bounds", "(%g, %g, %g) - (%g, %g, %g)",
+		bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z);
+
+	MeshArrays arrays;
+	arrays.vertices = vertices.data();
+	arrays.positions = positions.data();
+	arrays.indices = indices.data();
+	arrays.adjacency = adjacency.data();
+	arrays.edges = edges.data();
+	arrays.nverts = nverts;
+	arrays.ntris = ntris;
+	arrays.nedges = GLuint(edges.size() / 4);
+	arrays.bounds = bounds;
+
+	if (!MeshCache::write(output, input, weldEpsilon, arrays)) return false;
+	timer.stage("write", "%s", output);
+
+	printf("  %-16s %10.2f ms   ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", "total", timer.totalTime(),
+		before.acmr, fetched.acmr, before.atvr, fetched.atvr);
+	return true;
+}
+
+static void printUsage()
+{
+	printf("Usage: meshtool [-e epsilon] [-c cachesize] [-o output] file.obj ...\n");
+	printf("  -e epsilon    weld vertices closer than epsilon (default %g)\n", weldEpsilon);
+	printf("  -c cachesize  FIFO cache size for statistics and overdraw clusters (default %u)\n", cacheSize);
+	printf("  -o output     output file, only with a single input (default <file.obj>.mesh)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	const char* output = nullptr;
+	std::vector<const char*> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1 < argc);
+		if (strcmp(argv[i], "-e") == 0 && hasValue) {
+			weldEpsilon = float(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-c") == 0 && hasValue) {
+			cacheSize = GLuint(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-o") == 0 && hasValue) {
+			output = argv[++i];
+		}
+		else if (argv[i][0] == '-') {
+			printUsage();
+			return 1;
+		}
+		else {
+			inputs.push_back(argv[i]);
+		}
+	}
+
+	if (inputs.empty() || cacheSize == 0 || (output && inputs.size() > 1)) {
+		printUsage();
+		return 1;
+	}
+
+	int failures = 0;
+	for (const char* input : inputs)
+	{
+		std::string path = output ? std::string(output) : MeshCache::cachePath(input);
+		if (!processFile(input, path.c_str())) {
+			fprintf(stderr, "meshtool: failed to process %s\n", input);
+			failures++;
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+/*
+ *	Checks the CPU shadow volumes of SilhouetteExtractor without a GL context (see tools/Makefile).
+ *	A sphere and a torus are extruded from lights around them, and the written triangles are checked:
+ *	- with caps, every volume is closed and consistently wound, which z-fail needs
+ *	- finite z-pass volumes are the capped volumes without their front cap, so they are open only there
+ *	- the output does not depend on the number of threads
+ *
+ *	Usage: silhouettetest
+ */
+
+#include "MeshCreator.h"
+#include "HalfEdgeMesh.h"
+#include "SilhouetteExtractor.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+typedef std::vector<glm::vec4> Triangles; // 3 vertices per triangle
+
+static int failures = 0;
+
+static void check(bool condition, const char* what, int volume)
+{
+	if (!condition) {
+		printf("FAILED: %s (volume %d)\n", what, volume);
+		failures++;
+	}
+}
+
+// Vertices are compared exactly: the extractor computes a shared vertex the same way for every triangle
+static std::tuple<float, float, float, float> key(const glm::vec4& v)
+{
+	return std::make_tuple(v.x, v.y, v.z, v.w);
+}
+
+// Number of directed edges without an opposite edge. A closed, consistently wound surface has none
+static size_t countOpenEdges(const Triangles& triangles)
+{
+	typedef std::tuple<float, float, float, float> Vertex4;
+	std::map<std::pair<Vertex4, Vertex4>, int> edges;
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			Vertex4 a = key(triangles[t + k]), b = key(triangles[t + (k + 1) % 3]);
+			if (a == b) continue;
+			// An edge cancels its opposite edge
+			auto opposite = edges.find(std::make_pair(b, a));
+			if (opposite != edges.end() && --opposite->second == 0) edges.erase(opposite);
+			else if (opposite == edges.end()) edges[std::make_pair(a, b)]++;
+		}
+	}
+
+	size_t open = 0;
+	for (const auto& e : edges) open += e.second;
+	return open;
+}
+
+// Volume enclosed by finite triangles, positive when they face outwards
+static double signedVolume(const Triangles& triangles)
+{
+	double volume = 0.0;
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		glm::dvec3 a(triangles[t]), b(triangles[t + 1]), c(triangles[t + 2]);
+		volume += glm::dot(a, glm::cross(b, c)) / 6.0;
+	}
+	return volume;
+}
+
+// Triangles sorted by their vertices, for comparing triangle sets
+static std::vector<Triangles> sortedTriangles(const Triangles& triangles)
+{
+	std::vector<Triangles> sorted;
+	for (size_t t = 0; t < triangles.size(); t += 3) sorted.push_back(Triangles(&triangles[t], &triangles[t] + 3));
+	std::sort(sorted.begin(), sorted.end(), [](const Triangles& a, const Triangles& b) {
+		for (int k = 0; k < 3; k++)
+		{
+			if (key(a[k]) != key(b[k])) return key(a[k]) < key(b[k]);
+		}
+		return false;
+	});
+	return sorted;
+}
+
+// Extract and write the volumes of the casters, one triangle list per caster
+static std::vector<Triangles> extrude(const std::vector<ShadowCaster>& casters, const glm::vec3& light, unsigned threads)
+{
+	SilhouetteExtractor extractor;
+	extractor.extract(casters, light, threads);
+	Triangles all(extractor.totalVertices());
+	extractor.write(all.data(), threads);
+
+	std::vector<Triangles> volumes;
+	for (size_t i = 0; i < casters.size(); i++)
+	{
+		auto first = all.begin() + extractor.firstVertex(i);
+		volumes.push_back(Triangles(first, first + extractor.numVertices(i)));
+	}
+	return volumes;
+}
+
+// Torus around the z axis, as a second occluder with a saddle region and several silhouette loops
+static void generateTorus(float R, float r, int segments, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	const int rings = 2 * segments;
+	const float pi = 3.14159265f;
+	for (int i = 0; i < rings; i++)
+	{
+		for (int j = 0; j < segments; j++)
+		{
+			float u = 2.0f * pi * i / rings, v = 2.0f * pi * j / segments;
+			glm::vec3 normal(std::cos(u) * std::cos(v), std::sin(u) * std::cos(v), std::sin(v));
+			glm::vec3 position = glm::vec3(R * std::cos(u), R * std::sin(u), 0.0f) + r * normal;
+			vertices.push_back(Vertex{ position, normal, glm::vec2(0.0f) });
+		}
+	}
+
+	for (int i = 0; i < rings; i++)
+	{
+		for (int j = 0; j < segments; j++)
+		{
+			GLuint a = i * segments + j, b = ((i + 1) % rings) * segments + j;
+			GLuint c = ((i + 1) % rings) * segments + (j + 1) % segments, d = i * segments + (j + 1) % segments;
+			GLuint quad[] = { a, b, c, a, c, d };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+int main()
+{
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	HalfEdgeMesh sphere, torus;
+	MeshCreator::generateSphere(0.5f, 16, vertices, indices);
+	sphere.build(vertices, indices);
+	vertices.clear();
+	indices.clear();
+	generateTorus(1.0f, 0.3f, 24, vertices, indices);
+	torus.build(vertices, indices);
+
+	const HalfEdgeMesh* meshes[] = { &sphere, &torus };
+	const glm::vec3 lights[] = { glm::vec3(0.2f, 3.0f, 0.5f), glm::vec3(-2.0f, 0.3f, 1.5f), glm::vec3(0.0f, 0.0f, 4.0f) };
+	const float extrusionDistance = 20.0f;
+
+	// Infinite and finite volumes with caps and a finite z-pass volume for every mesh and light
+	int volume = 0;
+	for (const HalfEdgeMesh* mesh : meshes)
+	{
+		for (const glm::vec3& light : lights)
+		{
+			ShadowCaster caster;
+			caster.mesh = mesh;
+			caster.model = glm::rotate(glm::mat4(), 0.3f, glm::vec3(1.0f, 0.0f, 0.0f));
+
+			caster.caps = true;
+			caster.extrusionDistance = 0.0f;
+			Triangles infiniteCapped = extrude({ caster }, light, 1)[0];
+			caster.extrusionDistance = extrusionDistance;
+			Triangles finiteCapped = extrude({ caster }, light, 1)[0];
+			caster.caps = false;
+			Triangles finiteZPass = extrude({ caster }, light, 1)[0];
+
+			check(!infiniteCapped.empty(), "the caster has a silhouette", volume);
+			check(countOpenEdges(infiniteCapped) == 0, "an infinite capped volume is closed", volume);
+			check(countOpenEdges(finiteCapped) == 0, "a finite capped volume is closed", volume);
+			check(signedVolume(finiteCapped) > 0.0, "a finite capped volume faces outwards", volume);
+
+			// The front cap is the part of the capped volume that is not extruded
+			Triangles frontCap, rest;
+			for (size_t t = 0; t < finiteCapped.size(); t += 3)
+			{
+				bool front = true;
+				for (int k = 0; k < 3; k++)
+				{
+					front = front && glm::length(glm::vec3(finiteCapped[t + k]) - light) < 0.5f * extrusionDistance;
+				}
+				Triangles& part = front ? frontCap : rest;
+				part.insert(part.end(), &finiteCapped[t], &finiteCapped[t] + 3);
+			}
+
+			check(!frontCap.empty() && countOpenEdges(finiteZPass) > 0, "a finite z-pass volume is open", volume);
+			check(sortedTriangles(finiteZPass) == sortedTriangles(rest), "a finite z-pass volume has no front cap", volume);
+
+			Triangles closed = finiteZPass;
+			closed.insert(closed.end(), frontCap.begin(), frontCap.end());
+			check(countOpenEdges(closed) == 0, "a finite z-pass volume is open only at its front", volume);
+			volume++;
+		}
+	}
+
+	// Many casters of every kind, so the threads split them differently
+	std::vector<ShadowCaster> casters;
+	for (int i = 0; i < 24; i++)
+	{
+		ShadowCaster caster;
+		caster.mesh = meshes[i % 2];
+		caster.model = glm::translate(glm::mat4(), glm::vec3(0.7f * (i % 5), 0.5f * (i % 3), -0.4f * i));
+		caster.caps = (i % 3) == 0;
+		caster.extrusionDistance = (i % 4) < 2 ? 0.0f : extrusionDistance;
+		casters.push_back(caster);
+	}
+
+	std::vector<Triangles> serial = extrude(casters, lights[0], 1);
+	for (unsigned threads : { 2u, 3u, 8u, 0u })
+	{
+		std::vector<Triangles> parallel = extrude(casters, lights[0], threads);
+		bool same = true;
+		for (size_t i = 0; i < casters.size(); i++)
+		{
+			same = same && parallel[i].size() == serial[i].size()
+				&& std::memcmp(parallel[i].data(), serial[i].data(), serial[i].size() * sizeof(glm::vec4)) == 0;
+		}
+		check(same, "the output is the same on any number of threads", int(threads));
+	}
+
+	printf("silhouettetest: %s, %d meshes and lights and %zu casters checked\n", failures == 0 ? "passed" : "FAILED",
+		volume, casters.size());
+	return failures == 0 ? 0 : 1;
+}
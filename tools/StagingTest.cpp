@@ -0,0 +1,48 @@
+/*
+ *	Checks that generating meshes into the staging arena reuses its storage (see tools/Makefile).
+ *	Spheres are generated repeatedly, with the largest first, the way the application builds its
+ *	lamp and walls. After the first mesh the arena must neither grow nor move its storage.
+ *
+ *	Usage: stagingtest
+ */
+
+#include "MeshCreator.h"
+#include "StagingArena.h"
+
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+	if (!condition) {
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+int main()
+{
+	StagingArena arena;
+	const int segments[] = { 40, 40, 10, 25, 40, 2, 40 };
+
+	MeshCreator::generateSphere(1.0f, segments[0], arena.vertices(), arena.indices());
+	const size_t capacity = arena.capacityBytes();
+	const Vertex* vertexData = arena.vertices().data();
+	const GLuint* indexData = arena.indices().data();
+
+	for (int s : segments)
+	{
+		std::vector<Vertex>& vertices = arena.vertices();
+		std::vector<GLuint>& indices = arena.indices();
+		MeshCreator::generateSphere(1.0f, s, vertices, indices);
+
+		check(!vertices.empty() && !indices.empty(), "the sphere is generated into the arena");
+		check(arena.capacityBytes() == capacity, "the arena capacity stays flat across builds");
+		check(vertices.data() == vertexData && indices.data() == indexData, "the arena storage is reused");
+	}
+
+	printf("stagingtest: %s, %zu B held by the arena\n", failures == 0 ? "passed" : "FAILED", capacity);
+	return failures == 0 ? 0 : 1;
+}